@@ -1,4 +1,11 @@
 TEMPLATE = subdirs
-SUBDIRS = src/ui \
-    src/ui-tests
+SUBDIRS = syntaxindexer \
+    ui \
+    src/ui-tests \
+    src/benchmarks
+
+syntaxindexer.subdir = src/syntaxindexer
+ui.subdir = src/ui
+ui.depends = syntaxindexer
+
 QMAKE_DISTCLEAN += Makefile && rm -rf out
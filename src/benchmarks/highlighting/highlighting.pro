@@ -0,0 +1,16 @@
+# Headless benchmarks for the syntax highlighting engine in src/ui/ote/Highlighter.
+# Run with: ./highlighting-benchmark [-iterations N] [testfunction]
+# Corpus sizes can be scaled with the NQQ_BENCH_SCALE environment variable.
+# Set NQQ_BENCH_CORPUS to a directory of sample files to benchmark them as well,
+# and NQQ_BENCH_OUTPUT to a file name to get the results as JSON.
+
+QT += testlib
+CONFIG += c++14 testcase no_testcase_installs
+TEMPLATE = app
+TARGET = highlighting-benchmark
+
+DEFINES += NQQ_DATA_DIR=\\\"$$PWD/../../data\\\"
+
+include(../../ui/ote/Highlighter/Highlighter.pri)
+
+SOURCES += tst_highlightingbenchmark.cpp
@@ -0,0 +1,386 @@
+#include "../../ui/ote/Highlighter/abstracthighlighter.h"
+#include "../../ui/ote/Highlighter/definition.h"
+#include "../../ui/ote/Highlighter/format.h"
+#include "../../ui/ote/Highlighter/repository.h"
+#include "../../ui/ote/Highlighter/state.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QtTest>
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+// Every heap allocation of the process is counted, so the benchmarks can report allocations per line.
+static std::atomic<qint64> s_allocations(0);
+
+void* operator new(std::size_t size)
+{
+    ++s_allocations;
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    ++s_allocations;
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace {
+
+/**
+ * @brief The NullHighlighter class runs the rule engine without doing anything with its output,
+ *        so the benchmarks only measure highlightLine() itself.
+ */
+class NullHighlighter : public ote::AbstractHighlighter
+{
+public:
+    int highlight(const QStringList& lines)
+    {
+        ote::State state;
+        for (const auto& line : lines)
+            state = highlightLine(line, state);
+        return m_formats;
+    }
+
+protected:
+    void applyFormat(int, int, const ote::Format&) override { ++m_formats; }
+
+private:
+    int m_formats = 0;
+};
+
+// A short, typical snippet of each language. Corpora are made by repeating them.
+const char* const SAMPLE_CPP =
+    "#include <vector>\n"
+    "// Computes the sum of all values\n"
+    "template <typename T>\n"
+    "T sum(const std::vector<T>& values) {\n"
+    "    T total = 0; /* start at zero */\n"
+    "    for (const auto& v : values) total += v * 0x1F + 3.5e2;\n"
+    "    return total > 0 ? total : static_cast<T>(-1);\n"
+    "}\n"
+    "const char* s = \"string with \\\"escapes\\\" \\n\";\n";
+
+const char* const SAMPLE_JAVASCRIPT =
+    "// Fetches the list of users\n"
+    "async function loadUsers(url, options = {}) {\n"
+    "    const response = await fetch(`${url}/users?page=${options.page || 1}`);\n"
+    "    if (!response.ok) throw new Error('Request failed: ' + response.status);\n"
+    "    return (await response.json()).filter(u => /^[a-z]+$/i.test(u.name));\n"
+    "}\n";
+
+const char* const SAMPLE_PYTHON =
+    "import os\n"
+    "class Walker(object):\n"
+    "    \"\"\"Walks a directory tree.\"\"\"\n"
+    "    def __init__(self, root, depth=3):\n"
+    "        self.root = root  # the start directory\n"
+    "        self.depth = depth * 2 + 0.5\n"
+    "    def files(self):\n"
+    "        return [f for f in os.listdir(self.root) if f.endswith('.py')]\n";
+
+const char* const SAMPLE_XML =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<!-- A list of items -->\n"
+    "<items count=\"2\">\n"
+    "  <item id=\"1\" name=\"first\">Some &amp; text</item>\n"
+    "  <item id=\"2\"><![CDATA[raw <data>]]></item>\n"
+    "</items>\n";
+
+const char* const SAMPLE_HTML =
+    "<!DOCTYPE html>\n"
+    "<html><head><title>Page</title>\n"
+    "<style>body { color: #333; margin: 0 auto; }</style>\n"
+    "<script>var x = document.getElementById('main'); x.innerHTML = \"<b>hi</b>\";</script>\n"
+    "</head><body class=\"main\"><p>Text &copy; 2018</p></body></html>\n";
+
+const char* const SAMPLE_SQL =
+    "-- Users with recent orders\n"
+    "SELECT u.id, u.name, COUNT(o.id) AS orders\n"
+    "FROM users u LEFT JOIN orders o ON o.user_id = u.id\n"
+    "where o.created_at > '2018-01-01' and u.active = 1\n"
+    "GROUP BY u.id, u.name HAVING count(o.id) > 5 ORDER BY orders DESC;\n";
+
+const char* const SAMPLE_BASH =
+    "#!/bin/bash\n"
+    "# Backs up the given directories\n"
+    "for dir in \"$@\"; do\n"
+    "    if [ -d \"$dir\" ]; then\n"
+    "        tar -czf \"${dir%/}.tar.gz\" \"$dir\" && echo \"done: $dir\" || exit 1\n"
+    "    fi\n"
+    "done\n";
+
+/**
+ * @brief minifiedJavaScript Returns 'count' lines of minified JavaScript of about 'lineLength'
+ *        characters each.
+ */
+QStringList minifiedJavaScript(int count, int lineLength)
+{
+    QString statement = QString::fromLatin1(SAMPLE_JAVASCRIPT);
+    statement.remove(QRegularExpression(QStringLiteral("//[^\\n]*\\n")));
+    statement = statement.simplified();
+
+    QString line;
+    line.reserve(lineLength + statement.size());
+    while (line.size() < lineLength)
+        line += statement;
+
+    QStringList lines;
+    for (int i = 0; i < count; ++i)
+        lines << line;
+    return lines;
+}
+
+/**
+ * @brief singleLineJson Returns a JSON array of about 'size' characters on a single line.
+ */
+QStringList singleLineJson(int size)
+{
+    const QString element = QStringLiteral(
+        "{\"id\":12345,\"name\":\"value \\\"quoted\\\"\",\"tags\":[\"a\",\"b\"],"
+        "\"nested\":{\"x\":1.5e3,\"y\":null,\"z\":true}},");
+
+    QString json;
+    json.reserve(size + element.size() + 2);
+    json += QLatin1Char('[');
+    while (json.size() < size)
+        json += element;
+    json[json.size() - 1] = QLatin1Char(']');
+    return QStringList() << json;
+}
+
+/**
+ * @brief nestedXml Returns an XML document whose elements are nested 'depth' levels deep.
+ */
+QStringList nestedXml(int depth)
+{
+    QStringList lines;
+    lines << QStringLiteral("<?xml version=\"1.0\" encoding=\"UTF-8\"?>");
+    for (int i = 0; i < depth; ++i)
+        lines << QString(i % 64, QLatin1Char(' ')) + QStringLiteral("<node level=\"%1\" kind='inner'><!-- level %1 -->").arg(i);
+    lines << QStringLiteral("<leaf>text &amp; more text</leaf>");
+    for (int i = depth - 1; i >= 0; --i)
+        lines << QString(i % 64, QLatin1Char(' ')) + QStringLiteral("</node>");
+    return lines;
+}
+
+/**
+ * @brief timeOnce Runs 'f' once and returns the elapsed time in nanoseconds. Used to derive
+ *        throughput figures independently of the number of iterations QBENCHMARK chose.
+ */
+template <typename F>
+qint64 timeOnce(const F& f)
+{
+    QElapsedTimer timer;
+    timer.start();
+    f();
+    return timer.nsecsElapsed();
+}
+
+} // namespace
+
+/**
+ * @brief The HighlightingBenchmark class measures the throughput of the rule engine for a
+ *        few common languages and some synthetic worst cases, using the syntax definitions
+ *        shipped in src/data.
+ *        Every benchmark reports lines/s, bytes/s and allocations per line in addition to
+ *        QtTest's own timings. If NQQ_BENCH_OUTPUT is set, the results are also written to
+ *        that file as JSON so that runs can be compared, e.g. in CI.
+ *        Files in the NQQ_BENCH_CORPUS directory are benchmarked too, using the definition
+ *        matching their file name.
+ */
+class HighlightingBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void highlightLine_data();
+    void highlightLine();
+
+private:
+    void report(const QString& language, const QStringList& lines, qint64 nsecs, qint64 allocations);
+
+    std::unique_ptr<ote::Repository> m_repository;
+    int m_scale = 1;
+    QJsonArray m_results;
+};
+
+void HighlightingBenchmark::initTestCase()
+{
+    const QString dataDir = qEnvironmentVariableIsSet("NQQ_BENCH_DATA")
+                                ? QString::fromLocal8Bit(qgetenv("NQQ_BENCH_DATA"))
+                                : QStringLiteral(NQQ_DATA_DIR);
+    m_repository.reset(new ote::Repository(dataDir));
+    QVERIFY(!m_repository->definitions().isEmpty());
+
+    const int scale = qEnvironmentVariableIntValue("NQQ_BENCH_SCALE");
+    m_scale = scale > 0 ? scale : 1;
+}
+
+void HighlightingBenchmark::cleanupTestCase()
+{
+    const QString output = QString::fromLocal8Bit(qgetenv("NQQ_BENCH_OUTPUT"));
+    if (output.isEmpty())
+        return;
+
+    QFile file(output);
+    QVERIFY2(file.open(QIODevice::WriteOnly), qPrintable(file.errorString()));
+
+    QJsonObject root;
+    root.insert(QStringLiteral("benchmark"), QStringLiteral("highlighting"));
+    root.insert(QStringLiteral("scale"), m_scale);
+    root.insert(QStringLiteral("results"), m_results);
+    file.write(QJsonDocument(root).toJson());
+}
+
+void HighlightingBenchmark::report(const QString& language, const QStringList& lines, qint64 nsecs, qint64 allocations)
+{
+    if (nsecs <= 0)
+        return;
+
+    qint64 bytes = 0;
+    for (const auto& line : lines)
+        bytes += line.toUtf8().size() + 1;
+
+    const double secs = nsecs / 1e9;
+    const double allocationsPerLine = lines.isEmpty() ? 0 : double(allocations) / lines.size();
+    qInfo("%s: %.0f lines/s, %.1f MB/s, %.2f allocations/line (%d lines, %.1f MB)",
+          QTest::currentDataTag(),
+          lines.size() / secs,
+          bytes / secs / (1024 * 1024),
+          allocationsPerLine,
+          lines.size(),
+          bytes / (1024.0 * 1024.0));
+
+    QJsonObject result;
+    result.insert(QStringLiteral("name"), QString::fromUtf8(QTest::currentDataTag()));
+    result.insert(QStringLiteral("language"), language);
+    result.insert(QStringLiteral("lines"), lines.size());
+    result.insert(QStringLiteral("bytes"), double(bytes));
+    result.insert(QStringLiteral("nsecs"), double(nsecs));
+    result.insert(QStringLiteral("linesPerSecond"), lines.size() / secs);
+    result.insert(QStringLiteral("bytesPerSecond"), bytes / secs);
+    result.insert(QStringLiteral("allocationsPerLine"), allocationsPerLine);
+    m_results.append(result);
+}
+
+void HighlightingBenchmark::highlightLine_data()
+{
+    QTest::addColumn<QString>("language");
+    QTest::addColumn<QStringList>("lines");
+
+    const auto repeat = [this](const char* sample) {
+        const QStringList sampleLines = QString::fromLatin1(sample).split('\n');
+        QStringList lines;
+        for (int i = 0; i < 2000 * m_scale; ++i)
+            lines += sampleLines;
+        return lines;
+    };
+
+    QTest::newRow("c++")        << "C++"        << repeat(SAMPLE_CPP);
+    QTest::newRow("javascript") << "JavaScript" << repeat(SAMPLE_JAVASCRIPT);
+    QTest::newRow("python")     << "Python"     << repeat(SAMPLE_PYTHON);
+    QTest::newRow("xml")        << "XML"        << repeat(SAMPLE_XML);
+    QTest::newRow("html")       << "HTML"       << repeat(SAMPLE_HTML);
+    QTest::newRow("sql")        << "SQL"        << repeat(SAMPLE_SQL);
+    QTest::newRow("bash")       << "Bash"       << repeat(SAMPLE_BASH);
+
+    // Synthetic worst cases
+    QTest::newRow("minified-js")   << "JavaScript" << minifiedJavaScript(20 * m_scale, 100 * 1000);
+    QTest::newRow("json-10mb-line") << "JSON"      << singleLineJson(10 * 1000 * 1000 * m_scale);
+    QTest::newRow("xml-nested")    << "XML"        << nestedXml(5000 * m_scale);
+
+    // Real files, e.g. a checkout of sample sources for each language
+    const QString corpus = QString::fromLocal8Bit(qgetenv("NQQ_BENCH_CORPUS"));
+    if (corpus.isEmpty())
+        return;
+
+    const auto files = QDir(corpus).entryInfoList(QDir::Files, QDir::Name);
+    for (const auto& info : files) {
+        const auto definition = m_repository->definitionForFileName(info.fileName());
+        QFile file(info.filePath());
+        if (!definition.isValid() || !file.open(QIODevice::ReadOnly))
+            continue;
+
+        QTextStream stream(&file);
+        stream.setCodec("UTF-8");
+        const QStringList lines = stream.readAll().split('\n');
+        const QByteArray tag = "corpus/" + info.fileName().toUtf8();
+        QTest::newRow(tag.constData()) << definition.name() << lines;
+    }
+}
+
+void HighlightingBenchmark::highlightLine()
+{
+    QFETCH(QString, language);
+    QFETCH(QStringList, lines);
+
+    const auto definition = m_repository->definitionForName(language);
+    QVERIFY(definition.isValid());
+
+    NullHighlighter highlighter;
+    highlighter.setDefinition(definition);
+    highlighter.highlight(lines.mid(0, 100)); // Loads the definition
+
+    const auto run = [&] {
+        highlighter.highlight(lines);
+    };
+
+    QBENCHMARK {
+        run();
+    }
+
+    const qint64 allocationsBefore = s_allocations;
+    const qint64 nsecs = timeOnce(run);
+    report(language, lines, nsecs, s_allocations - allocationsBefore);
+}
+
+QTEST_GUILESS_MAIN(HighlightingBenchmark)
+
+#include "tst_highlightingbenchmark.moc"
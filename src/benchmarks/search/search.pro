@@ -0,0 +1,16 @@
+# Headless benchmarks for the search engines in src/ui/Search.
+# Run with: ./search-benchmark [-iterations N] [testfunction]
+# Corpus sizes can be scaled with the NQQ_BENCH_SCALE environment variable.
+
+QT += testlib
+QT += core gui svg widgets printsupport network dbus
+CONFIG += c++14 link_pkgconfig testcase no_testcase_installs
+PKGCONFIG += uchardet
+TEMPLATE = app
+TARGET = search-benchmark
+
+DEFINES += QT_NO_URL_CAST_FROM_STRING
+
+include(../../ui/ui.pri)
+
+SOURCES += tst_searchbenchmark.cpp
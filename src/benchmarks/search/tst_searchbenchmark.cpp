@@ -0,0 +1,362 @@
+#include "include/Search/filereplacer.h"
+#include "include/Search/filesearcher.h"
+#include "include/Search/searchobjects.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+#include <QTemporaryDir>
+#include <QTextCodec>
+#include <QtTest>
+
+/**
+ * @brief The SearchBenchmark class measures the throughput of FileSearcher and FileReplacer
+ *        on generated corpora: many small files, a few huge files, very long lines and files
+ *        in mixed encodings. Every benchmark reports MB/s and matches/s in addition to QtTest's
+ *        own timings so that results can be compared across machines and runs.
+ */
+class SearchBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void searchPlainText_data();
+    void searchPlainText();
+    void searchRegExp_data();
+    void searchRegExp();
+    void getLinePositions_data();
+    void getLinePositions();
+    void replaceAll_data();
+    void replaceAll();
+    void fileSearcher_data();
+    void fileSearcher();
+
+private:
+    enum Corpus {
+        CorpusSmallFiles,
+        CorpusHugeFiles,
+        CorpusLongLines,
+        CorpusMixedEncodings
+    };
+
+    void addCorpusColumns();
+    QString corpusText(Corpus corpus) const;
+    QString corpusDirectory(Corpus corpus) const;
+    void writeCorpus(Corpus corpus, const QString& subDir, int fileCount, int fileSize, int lineLength);
+    void report(qint64 bytes, int matches, qint64 nsecs) const;
+
+    QTemporaryDir m_dir;
+    int m_scale = 1;
+    QHash<int, QString> m_texts; // Concatenated decoded text of each corpus
+    QHash<int, qint64> m_bytes;  // Size in bytes of each corpus on disk
+};
+
+namespace {
+
+const char* const WORDS[] = {
+    "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+    "notepadqq", "search", "replace", "QString", "int", "return", "nullptr", "void",
+    "\xc3\xa4rger", "\xc3\xa9t\xc3\xa9", "na\xc3\xafve", "stra\xc3\x9f" "e", // Non-ASCII words, as UTF-8
+};
+const int WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+
+/**
+ * @brief generateText Deterministically creates roughly 'size' characters of text made of
+ *        words from WORDS, broken into lines of about 'lineLength' characters.
+ */
+QString generateText(quint32 seed, int size, int lineLength)
+{
+    QString text;
+    text.reserve(size + lineLength);
+    int lineStart = 0;
+
+    while (text.size() < size) {
+        seed = seed * 1103515245u + 12345u;
+        text += QString::fromUtf8(WORDS[(seed >> 16) % WORD_COUNT]);
+
+        if (text.size() - lineStart >= lineLength) {
+            text += '\n';
+            lineStart = text.size();
+        } else {
+            text += ' ';
+        }
+    }
+
+    return text;
+}
+
+/**
+ * @brief timeOnce Runs 'f' once and returns the elapsed time in nanoseconds. Used to derive
+ *        throughput figures independently of the number of iterations QBENCHMARK chose.
+ */
+template <typename F>
+qint64 timeOnce(const F& f)
+{
+    QElapsedTimer timer;
+    timer.start();
+    f();
+    return timer.nsecsElapsed();
+}
+
+} // namespace
+
+void SearchBenchmark::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+
+    const int scale = qEnvironmentVariableIntValue("NQQ_BENCH_SCALE");
+    m_scale = scale > 0 ? scale : 1;
+
+    writeCorpus(CorpusSmallFiles,       "small",    1000 * m_scale, 4 * 1024,               80);
+    writeCorpus(CorpusHugeFiles,        "huge",     2,              16 * 1024 * 1024 * m_scale, 100);
+    writeCorpus(CorpusLongLines,        "long",     4,              4 * 1024 * 1024 * m_scale,  1024 * 1024);
+    writeCorpus(CorpusMixedEncodings,   "mixed",    300 * m_scale,  16 * 1024,              120);
+}
+
+void SearchBenchmark::writeCorpus(Corpus corpus, const QString& subDir, int fileCount, int fileSize, int lineLength)
+{
+    QDir(m_dir.path()).mkpath(subDir);
+
+    QTextCodec* const utf16 = QTextCodec::codecForName("UTF-16LE");
+    QTextCodec* const latin1 = QTextCodec::codecForName("ISO-8859-1");
+
+    QString& all = m_texts[corpus];
+    qint64& bytes = m_bytes[corpus];
+
+    for (int i = 0; i < fileCount; ++i) {
+        const QString text = generateText(static_cast<quint32>(corpus * 100000 + i), fileSize, lineLength);
+        QByteArray data;
+
+        if (corpus == CorpusMixedEncodings && i % 3 == 1) {
+            data = QByteArray("\xff\xfe", 2) + utf16->fromUnicode(text);
+        } else if (corpus == CorpusMixedEncodings && i % 3 == 2) {
+            data = latin1->fromUnicode(text);
+        } else {
+            data = text.toUtf8();
+        }
+
+        QFile f(QString("%1/%2/file%3.txt").arg(m_dir.path(), subDir).arg(i));
+        QVERIFY(f.open(QIODevice::WriteOnly));
+        QCOMPARE(f.write(data), qint64(data.size()));
+
+        all += text;
+        bytes += data.size();
+    }
+}
+
+QString SearchBenchmark::corpusText(Corpus corpus) const
+{
+    return m_texts.value(corpus);
+}
+
+QString SearchBenchmark::corpusDirectory(Corpus corpus) const
+{
+    static const char* const dirs[] = { "small", "huge", "long", "mixed" };
+    return m_dir.path() + '/' + dirs[corpus];
+}
+
+void SearchBenchmark::addCorpusColumns()
+{
+    QTest::addColumn<int>("corpus");
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<bool>("matchCase");
+}
+
+void SearchBenchmark::report(qint64 bytes, int matches, qint64 nsecs) const
+{
+    if (nsecs <= 0)
+        return;
+
+    const double secs = nsecs / 1e9;
+    qInfo("%s: %.1f MB/s, %.0f matches/s (%d matches, %.1f MB)",
+          QTest::currentDataTag(),
+          bytes / secs / (1024 * 1024),
+          matches / secs,
+          matches,
+          bytes / (1024.0 * 1024.0));
+}
+
+void SearchBenchmark::searchPlainText_data()
+{
+    addCorpusColumns();
+    QTest::newRow("small-files")     << int(CorpusSmallFiles)     << "notepadqq" << true;
+    QTest::newRow("huge-files")      << int(CorpusHugeFiles)      << "notepadqq" << true;
+    QTest::newRow("huge-files-ci")   << int(CorpusHugeFiles)      << "NOTEPADQQ" << false;
+    QTest::newRow("long-lines")      << int(CorpusLongLines)      << "notepadqq" << true;
+    QTest::newRow("mixed-encodings") << int(CorpusMixedEncodings) << QString::fromUtf8("\xc3\xa9t\xc3\xa9") << true;
+    QTest::newRow("rare")            << int(CorpusHugeFiles)      << "not in corpus" << true;
+}
+
+void SearchBenchmark::searchPlainText()
+{
+    QFETCH(int, corpus);
+    QFETCH(QString, pattern);
+    QFETCH(bool, matchCase);
+
+    const QString text = corpusText(Corpus(corpus));
+    SearchConfig config;
+    config.searchString = pattern;
+    config.matchCase = matchCase;
+
+    int matches = 0;
+    const auto run = [&] {
+        matches = FileSearcher::searchPlainText(config, text).results.size();
+    };
+
+    QBENCHMARK {
+        run();
+    }
+    const qint64 nsecs = timeOnce(run);
+    report(text.size() * qint64(sizeof(QChar)), matches, nsecs);
+}
+
+void SearchBenchmark::searchRegExp_data()
+{
+    addCorpusColumns();
+    QTest::newRow("small-files-literal")   << int(CorpusSmallFiles)     << "notepadqq"          << true;
+    QTest::newRow("huge-files-literal")    << int(CorpusHugeFiles)      << "notepadqq"          << true;
+    QTest::newRow("huge-files-class")      << int(CorpusHugeFiles)      << "\\b[A-Z]\\w+\\b"    << true;
+    QTest::newRow("huge-files-alt-ci")     << int(CorpusHugeFiles)      << "(void|int) (\\w+)"  << false;
+    QTest::newRow("long-lines-anchored")   << int(CorpusLongLines)      << "^lorem"             << true;
+    QTest::newRow("mixed-encodings")       << int(CorpusMixedEncodings) << "na.ve|\\w+\\xdf\\w" << true;
+}
+
+void SearchBenchmark::searchRegExp()
+{
+    QFETCH(int, corpus);
+    QFETCH(QString, pattern);
+    QFETCH(bool, matchCase);
+
+    const QString text = corpusText(Corpus(corpus));
+    SearchConfig config;
+    config.searchString = pattern;
+    config.matchCase = matchCase;
+    config.searchMode = SearchConfig::ModeRegex;
+    const QRegularExpression regex = FileSearcher::createRegexFromConfig(config);
+
+    int matches = 0;
+    const auto run = [&] {
+        matches = FileSearcher::searchRegExp(regex, text).results.size();
+    };
+
+    QBENCHMARK {
+        run();
+    }
+    const qint64 nsecs = timeOnce(run);
+    report(text.size() * qint64(sizeof(QChar)), matches, nsecs);
+}
+
+void SearchBenchmark::getLinePositions_data()
+{
+    QTest::addColumn<int>("corpus");
+    QTest::newRow("small-files") << int(CorpusSmallFiles);
+    QTest::newRow("huge-files")  << int(CorpusHugeFiles);
+    QTest::newRow("long-lines")  << int(CorpusLongLines);
+}
+
+void SearchBenchmark::getLinePositions()
+{
+    QFETCH(int, corpus);
+
+    const QString text = corpusText(Corpus(corpus));
+
+    int lines = 0;
+    const auto run = [&] {
+        lines = static_cast<int>(::getLinePositions(text).size());
+    };
+
+    QBENCHMARK {
+        run();
+    }
+    const qint64 nsecs = timeOnce(run);
+    report(text.size() * qint64(sizeof(QChar)), lines, nsecs);
+}
+
+void SearchBenchmark::replaceAll_data()
+{
+    addCorpusColumns();
+    QTest::addColumn<QString>("replacement");
+    QTest::addColumn<int>("mode");
+    QTest::newRow("plain")        << int(CorpusHugeFiles) << "notepadqq"          << true << "editor"   << int(SearchConfig::ModePlainText);
+    QTest::newRow("backrefs")     << int(CorpusHugeFiles) << "(void|int) (\\w+)"  << true << "\\2 \\1"  << int(SearchConfig::ModeRegex);
+    QTest::newRow("long-lines")   << int(CorpusLongLines) << "amet"               << true << ""         << int(SearchConfig::ModeRegex);
+}
+
+void SearchBenchmark::replaceAll()
+{
+    QFETCH(int, corpus);
+    QFETCH(QString, pattern);
+    QFETCH(bool, matchCase);
+    QFETCH(QString, replacement);
+    QFETCH(int, mode);
+
+    const QString text = corpusText(Corpus(corpus));
+    SearchConfig config;
+    config.searchString = pattern;
+    config.matchCase = matchCase;
+    config.searchMode = SearchConfig::SearchMode(mode);
+    const DocResult doc = config.searchMode == SearchConfig::ModeRegex ?
+                FileSearcher::searchRegExp(FileSearcher::createRegexFromConfig(config), text) :
+                FileSearcher::searchPlainText(config, text);
+
+    const auto run = [&] {
+        QString content = text;
+        FileReplacer::replaceAll(doc, content, replacement);
+    };
+
+    QBENCHMARK {
+        run();
+    }
+    const qint64 nsecs = timeOnce(run);
+    report(text.size() * qint64(sizeof(QChar)), doc.results.size(), nsecs);
+}
+
+void SearchBenchmark::fileSearcher_data()
+{
+    QTest::addColumn<int>("corpus");
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<int>("mode");
+    QTest::newRow("small-files-plain")     << int(CorpusSmallFiles)     << "notepadqq"        << int(SearchConfig::ModePlainText);
+    QTest::newRow("small-files-regex")     << int(CorpusSmallFiles)     << "(void|int) \\w+"  << int(SearchConfig::ModeRegex);
+    QTest::newRow("huge-files-plain")      << int(CorpusHugeFiles)      << "notepadqq"        << int(SearchConfig::ModePlainText);
+    QTest::newRow("huge-files-regex")      << int(CorpusHugeFiles)      << "(void|int) \\w+"  << int(SearchConfig::ModeRegex);
+    QTest::newRow("long-lines-plain")      << int(CorpusLongLines)      << "notepadqq"        << int(SearchConfig::ModePlainText);
+    QTest::newRow("mixed-encodings-plain") << int(CorpusMixedEncodings) << "notepadqq"        << int(SearchConfig::ModePlainText);
+}
+
+void SearchBenchmark::fileSearcher()
+{
+    QFETCH(int, corpus);
+    QFETCH(QString, pattern);
+    QFETCH(int, mode);
+
+    SearchConfig config;
+    config.searchString = pattern;
+    config.matchCase = true;
+    config.searchMode = SearchConfig::SearchMode(mode);
+    config.searchScope = SearchConfig::ScopeFileSystem;
+    config.directory = corpusDirectory(Corpus(corpus));
+    config.filePattern = "*.txt";
+
+    int matches = 0;
+    const auto run = [&] {
+        FileSearcher* searcher = FileSearcher::prepareAsyncSearch(config);
+        searcher->start();
+        searcher->wait();
+        matches = searcher->getResult().countResults();
+        delete searcher;
+    };
+
+    QBENCHMARK {
+        run();
+    }
+    const qint64 nsecs = timeOnce(run);
+    report(m_bytes.value(corpus), matches, nsecs);
+}
+
+QTEST_GUILESS_MAIN(SearchBenchmark)
+
+#include "tst_searchbenchmark.moc"
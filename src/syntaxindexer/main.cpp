@@ -0,0 +1,34 @@
+#include "../ui/ote/Highlighter/definition.h"
+#include "../ui/ote/Highlighter/repository_p.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QTextStream>
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream err(stderr);
+
+    const QStringList args = app.arguments();
+    if (args.size() < 2 || args.size() > 3) {
+        err << "Usage: syntaxindexer <syntax folder> [<index file>]\n";
+        return 1;
+    }
+
+    const QString path = args.at(1);
+    const QString indexFileName = args.size() == 3 ? args.at(2) : path + "/index.katesyntax";
+
+    const auto defs = ote::RepositoryPrivate::loadSyntaxFolderFromXml(nullptr, path);
+    if (defs.isEmpty()) {
+        err << "No syntax definitions found in " << QDir::toNativeSeparators(path) << "\n";
+        return 1;
+    }
+
+    if (!ote::RepositoryPrivate::saveSyntaxIndex(defs, indexFileName)) {
+        err << "Could not write " << QDir::toNativeSeparators(indexFileName) << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,16 @@
+# Build-time tool that writes index.katesyntax for a folder of syntax definitions,
+# so that Notepadqq doesn't need to parse the XML files on startup.
+# Run with: ./syntaxindexer <syntax folder> [<index file>]
+
+CONFIG += console c++14
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = syntaxindexer
+
+DESTDIR = ../../out/build_tools
+MOC_DIR = ../../out/build_tools/obj
+OBJECTS_DIR = ../../out/build_tools/obj
+
+include(../ui/ote/Highlighter/Highlighter.pri)
+
+SOURCES += main.cpp
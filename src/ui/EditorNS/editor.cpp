@@ -15,26 +15,50 @@
 #include <QMessageBox>
 #include <QRegExp>
 #include <QRegularExpression>
+#include <QTextBlock>
+#include <QTextCursor>
 #include <QTimer>
 #include <QUrlQuery>
 #include <QVBoxLayout>
 
+#include <algorithm>
+
 namespace EditorNS
 {
     Editor::Editor(QWidget* parent)
         : QWidget(parent)
         , m_textEditor(new ote::TextEdit(parent))
+        , m_shared(std::make_shared<SharedState>())
     {
         const auto& repo = ote::TextEdit::getRepository();
 
         QString themeName = NqqSettings::getInstance().Appearance.getColorScheme();
         auto theme = repo.theme(themeName);
 
-        fullConstructor(theme);
+        fullConstructor(theme, ote::Definition());
+    }
+
+    Editor::Editor(Editor* source, QWidget* parent)
+        : QWidget(parent)
+        , m_textEditor(new ote::TextEdit(parent, source->m_textEditor, source->m_textEditor->getConfig()))
+        , m_filePath(source->m_filePath)
+        , m_loaded(source->m_loaded)
+        , m_shared(source->m_shared)
+    {
+        // The shared highlighter already uses the source's language and theme.
+        fullConstructor(source->m_textEditor->getTheme(), source->getLanguage());
     }
 
-    void Editor::fullConstructor(const ote::Theme& theme) // FIXME: Should use new Theme
+    Editor::~Editor()
     {
+        auto& editors = m_shared->editors;
+        editors.erase(std::remove(editors.begin(), editors.end(), this), editors.end());
+    }
+
+    void Editor::fullConstructor(const ote::Theme& theme, const ote::Definition& language) // FIXME: Should use new Theme
+    {
+        m_shared->editors.push_back(this);
+
         m_layout = new QVBoxLayout(this);
         m_layout->setContentsMargins(0, 0, 0, 0);
         m_layout->setSpacing(0);
@@ -42,7 +66,7 @@ namespace EditorNS
         setLayout(m_layout);
 
         setTheme(theme);
-        setLanguage(nullptr);
+        setLanguage(language);
 
         connect(m_textEditor, &ote::TextEdit::textChanged, this, &Editor::contentChanged);
         connect(m_textEditor, &ote::TextEdit::cursorPositionChanged, this, &Editor::cursorActivity);
@@ -68,6 +92,28 @@ namespace EditorNS
         return new Editor(parent);
     }
 
+    QSharedPointer<Editor> Editor::getClonedEditor(Editor *source, QWidget *parent)
+    {
+        QSharedPointer<Editor> clone(new Editor(source, parent), &Editor::deleteLater);
+
+        // Saving as a different file from one view moves all views of the document.
+        auto syncFilePath = [](Editor *from, Editor *to) {
+            connect(from, &Editor::fileNameChanged, to, [to](const QUrl&, const QUrl &newFileName) {
+                if (to->filePath() != newFileName)
+                    to->setFilePath(newFileName);
+            });
+        };
+        syncFilePath(source, clone.data());
+        syncFilePath(clone.data(), source);
+
+        return clone;
+    }
+
+    bool Editor::isDocumentShared() const
+    {
+        return m_textEditor->isDocumentShared();
+    }
+
     void Editor::setFocus()
     {
         m_textEditor->setFocus();
@@ -134,14 +180,20 @@ namespace EditorNS
     void Editor::setLanguage(ote::Definition def)
     {
         // We use setLanguage() also when changing indentation modes, so this needs to be up here.
-        if (!m_customIndentationMode)
+        if (!m_shared->customIndentationMode)
             setIndentationMode(def);
 
         if (m_textEditor->getDefinition() == def)
             return;
 
+        // The definition lives in the shared highlighter, so the other views of the document
+        // wouldn't notice the change on their own.
         m_textEditor->setDefinition(def);
-        emit currentLanguageChanged(def.name());
+        for (Editor* editor : m_shared->editors) {
+            if (editor != this && !m_shared->customIndentationMode)
+                editor->setIndentationMode(def);
+            emit editor->currentLanguageChanged(def.name());
+        }
     }
 
     void Editor::setLanguage(const QString& language)
@@ -170,7 +222,12 @@ namespace EditorNS
             return;
         }
 
-        def = m_textEditor->getRepository().definitionForContent(value());
+        // Only the beginning of the first line is needed, don't copy the whole document.
+        QTextCursor prefix(m_textEditor->document());
+        const int prefixLength = std::min(m_textEditor->document()->firstBlock().length() - 1,
+                                          ote::Repository::MAX_CONTENT_DETECTION_LENGTH);
+        prefix.setPosition(prefixLength, QTextCursor::KeepAnchor);
+        def = m_textEditor->getRepository().definitionForContent(prefix.selectedText());
         if (def.isValid()) {
             setLanguage(def);
             return;
@@ -194,6 +251,12 @@ namespace EditorNS
         m_textEditor->setTabToSpaces(!useTabs);
     }
 
+    void Editor::setSharedIndentationMode(const bool useTabs, const int size)
+    {
+        for (Editor* editor : m_shared->editors)
+            editor->setIndentationMode(useTabs, size);
+    }
+
     Editor::IndentationMode Editor::indentationMode()
     {
         auto tabWidth = m_textEditor->getConfig().tabWidth;
@@ -203,25 +266,25 @@ namespace EditorNS
 
     void Editor::setCustomIndentationMode(const bool useTabs, const int size)
     {
-        m_customIndentationMode = true;
-        setIndentationMode(useTabs, size);
+        m_shared->customIndentationMode = true;
+        setSharedIndentationMode(useTabs, size);
     }
 
     void Editor::setCustomIndentationMode(const bool useTabs)
     {
-        m_customIndentationMode = true;
-        setIndentationMode(useTabs, 0);
+        m_shared->customIndentationMode = true;
+        setSharedIndentationMode(useTabs, 0);
     }
 
     void Editor::clearCustomIndentationMode()
     {
-        m_customIndentationMode = false;
+        m_shared->customIndentationMode = false;
         // setIndentationMode(getLanguage()); // FIXME
     }
 
     bool Editor::isUsingCustomIndentationMode() const
     {
-        return m_customIndentationMode;
+        return m_shared->customIndentationMode;
     }
 
     void EditorNS::Editor::setZoomLevel(int level)
@@ -261,12 +324,12 @@ namespace EditorNS
 
     bool Editor::fileOnDiskChanged() const
     {
-        return m_fileOnDiskChanged;
+        return m_shared->fileOnDiskChanged;
     }
 
     void Editor::setFileOnDiskChanged(bool fileOnDiskChanged)
     {
-        m_fileOnDiskChanged = fileOnDiskChanged;
+        m_shared->fileOnDiskChanged = fileOnDiskChanged;
     }
 
     void Editor::setSelectionsText(const QStringList &texts, SelectMode mode)
@@ -372,12 +435,12 @@ namespace EditorNS
 
     QString Editor::endOfLineSequence() const
     {
-        return m_endOfLineSequence;
+        return m_shared->endOfLineSequence;
     }
 
     void Editor::setEndOfLineSequence(const QString &newLineSequence)
     {
-        m_endOfLineSequence = newLineSequence;
+        m_shared->endOfLineSequence = newLineSequence;
     }
 
     void Editor::setFont(const QFont& font)
@@ -387,22 +450,22 @@ namespace EditorNS
 
     QTextCodec *Editor::codec() const
     {
-        return m_codec;
+        return m_shared->codec;
     }
 
     void Editor::setCodec(QTextCodec *codec)
     {
-        m_codec = codec;
+        m_shared->codec = codec;
     }
 
     bool Editor::bom() const
     {
-        return m_bom;
+        return m_shared->bom;
     }
 
     void Editor::setBom(bool bom)
     {
-        m_bom = bom;
+        m_shared->bom = bom;
     }
 
     void Editor::setTheme(const ote::Theme& theme)
@@ -2,10 +2,12 @@
 
 #include "include/EditorNS/editor.h"
 #include "include/Search/filereplacer.h"
+#include "include/Search/searchresultfile.h"
 #include "include/Search/searchstring.h"
 #include "include/iconprovider.h"
 #include "include/mainwindow.h"
 #include "include/nqqsettings.h"
+#include "ote/Highlighter/regexengine.h"
 
 #include <QApplication>
 #include <QCheckBox>
@@ -165,6 +167,10 @@ QLayout* AdvancedSearchDock::buildLeftTitlebar() {
     m_btnClearHistory->setIcon(IconProvider::fromTheme("edit-clear"));
     m_btnClearHistory->setToolTip(tr("Clear Search History"));
 
+    m_btnOpenResults = new QToolButton;
+    m_btnOpenResults->setIcon(IconProvider::fromTheme("document-open"));
+    m_btnOpenResults->setToolTip(tr("Open Saved Search Results"));
+
     m_cmbSearchHistory = new QComboBox;
     m_cmbSearchHistory->setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::Preferred);
     m_cmbSearchHistory->setMinimumWidth(120);
@@ -187,6 +193,7 @@ QLayout* AdvancedSearchDock::buildLeftTitlebar() {
     m_actCopyContents = menu->addAction(tr("Copy Selected Contents To Clipboard"));
     m_actShowFullLines = menu->addAction(tr("Show Full Lines"));
     m_actShowFullLines->setCheckable(true);
+    m_actExportResults = menu->addAction(tr("Export Results..."));
     m_actRemoveSearch= menu->addAction(tr("Remove This Search"));
 
     m_btnMoreOptions = new QToolButton;
@@ -203,6 +210,7 @@ QLayout* AdvancedSearchDock::buildLeftTitlebar() {
     QHBoxLayout* layout = new QHBoxLayout;
     layout->addWidget(label);
     layout->addWidget(m_btnClearHistory);
+    layout->addWidget(m_btnOpenResults);
     layout->addWidget(m_cmbSearchHistory);
     layout->addSpacerItem(new QSpacerItem(40, 1, QSizePolicy::Fixed, QSizePolicy::Minimum));
     layout->addWidget(m_btnPrevResult);
@@ -541,10 +549,18 @@ void AdvancedSearchDock::updateSearchInProgressUi()
     // Some actions are only available when the search is finished
     const bool progress = m_currentSearchInstance->isSearchInProgress();
 
+    // Results loaded from a file may not match the files anymore. Replacing at their positions could
+    // corrupt them, so they can only be viewed.
+    const bool readOnly = m_currentSearchInstance->isReadOnly();
+    if (readOnly)
+        m_btnToggleReplaceOptions->setChecked(false);
+
     m_actExpandAll->setEnabled(!progress);
     m_actCopyContents->setEnabled(!progress);
     m_actShowFullLines->setEnabled(!progress);
-    m_btnToggleReplaceOptions->setVisible(!progress);
+    m_actRedoSearch->setEnabled(!readOnly);
+    m_btnReplaceSelected->setEnabled(!readOnly);
+    m_btnToggleReplaceOptions->setVisible(!progress && !readOnly);
 
     m_btnPrevResult->setVisible(!progress);
     m_btnNextResult->setVisible(!progress);
@@ -552,7 +568,7 @@ void AdvancedSearchDock::updateSearchInProgressUi()
 
 void AdvancedSearchDock::startReplace()
 {
-    if (!m_currentSearchInstance)
+    if (!m_currentSearchInstance || m_currentSearchInstance->isReadOnly())
         return;
 
     QString replaceText = m_cmbReplaceText->currentText();
@@ -591,6 +607,7 @@ void AdvancedSearchDock::startReplace()
 
 SearchConfig AdvancedSearchDock::getConfigFromInputs()
 {
+    NqqSettings& settings = NqqSettings::getInstance();
     SearchConfig config;
     config.directory = m_cmbSearchDirectory->currentText();
     config.filePattern = m_cmbSearchPattern->currentText();
@@ -605,6 +622,9 @@ SearchConfig AdvancedSearchDock::getConfigFromInputs()
     else if (m_chkUseRegex->isChecked())
         config.searchMode = SearchConfig::ModeRegex;
     config.includeSubdirs = m_chkIncludeSubdirs->isChecked();
+    config.maxMatchSpan = settings.Search.getRegexMaxMatchSpan();
+    config.regexBacktrackLimit = settings.Search.getRegexBacktrackLimit();
+    config.regexTimeLimit = settings.Search.getRegexTimeLimit();
     config.targetWindow = m_mainWindow;
 
     return config;
@@ -656,6 +676,7 @@ AdvancedSearchDock::AdvancedSearchDock(MainWindow* mainWindow)
 
     // Titlebar connections
     connect(m_btnClearHistory, &QToolButton::clicked, this, &AdvancedSearchDock::clearHistory);
+    connect(m_btnOpenResults, &QToolButton::clicked, this, &AdvancedSearchDock::openResults);
     connect(m_cmbSearchHistory, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
             this, &AdvancedSearchDock::selectSearchFromHistory);
     connect(m_btnPrevResult, &QToolButton::clicked, this, &AdvancedSearchDock::selectPrevResult);
@@ -729,12 +750,15 @@ AdvancedSearchDock::AdvancedSearchDock(MainWindow* mainWindow)
         m_currentSearchInstance->showFullLines(checked);
     });
     connect(m_actRedoSearch, &QAction::triggered, [this](){
+        if (m_currentSearchInstance->isReadOnly())
+            return;
         setInputsFromConfig( m_currentSearchInstance->getSearchConfig() );
         m_cmbSearchHistory->setCurrentIndex(0);
     });
     connect(m_actCopyContents, &QAction::triggered, [this](){
         m_currentSearchInstance->copySelectedLinesToClipboard();
     });
+    connect(m_actExportResults, &QAction::triggered, this, &AdvancedSearchDock::exportResults);
     connect(m_actRemoveSearch, &QAction::triggered, [this](){
         if (m_currentSearchInstance->isSearchInProgress()) {
             const auto response = QMessageBox::warning(
@@ -842,6 +866,18 @@ void AdvancedSearchDock::startSearch(SearchConfig cfg)
     if (cfg.searchString.isEmpty())
         return;
 
+    if (cfg.searchMode == SearchConfig::ModeRegex) {
+        const QRegularExpression regex = FileSearcher::createRegexFromConfig(cfg);
+
+        if (!regex.isValid()) {
+            QMessageBox::warning(QApplication::activeWindow(), tr("Error"),
+                                 tr("Invalid regular expression: %1 (at position %2)")
+                                 .arg(regex.errorString())
+                                 .arg(ote::RegexEngine::patternErrorOffset(regex)), QMessageBox::Ok);
+            return;
+        }
+    }
+
     const SearchConfig::SearchScope scope = cfg.searchScope;
 
     if (scope == SearchConfig::ScopeFileSystem) {
@@ -866,7 +902,14 @@ void AdvancedSearchDock::startSearch(SearchConfig cfg)
         updateFilterHistory(cfg.filePattern);
     }
 
-    m_searchInstances.push_back( std::unique_ptr<SearchInstance>(new SearchInstance(cfg)) );
+    addSearchInstance(new SearchInstance(cfg));
+}
+
+void AdvancedSearchDock::addSearchInstance(SearchInstance* instance)
+{
+    const SearchConfig& cfg = instance->getSearchConfig();
+
+    m_searchInstances.push_back( std::unique_ptr<SearchInstance>(instance) );
 
     m_cmbSearchHistory->addItem( cfg.getScopeAsString() + ": \"" + cfg.searchString + "\"" );
     m_cmbSearchHistory->setCurrentIndex( m_cmbSearchHistory->count()-1 );
@@ -874,6 +917,47 @@ void AdvancedSearchDock::startSearch(SearchConfig cfg)
     onSearchHistorySizeChange();
 }
 
+void AdvancedSearchDock::exportResults()
+{
+    if (!m_currentSearchInstance || m_currentSearchInstance->isSearchInProgress())
+        return;
+
+    const QString fileName = QFileDialog::getSaveFileName(QApplication::activeWindow(), tr("Export Search Results"),
+                                                          NqqSettings::getInstance().General.getLastSelectedDir(),
+                                                          tr("Search Results (*.nqqsearch)"));
+    if (fileName.isEmpty())
+        return;
+
+    if (!SearchResultFile::save(fileName, m_currentSearchInstance->getSearchConfig(),
+                                m_currentSearchInstance->getSearchResult())) {
+        QMessageBox::warning(QApplication::activeWindow(), tr("Error"),
+                             tr("Error while trying to save the search results to %1.").arg(fileName),
+                             QMessageBox::Ok);
+    }
+}
+
+void AdvancedSearchDock::openResults()
+{
+    const QString fileName = QFileDialog::getOpenFileName(QApplication::activeWindow(), tr("Open Search Results"),
+                                                          NqqSettings::getInstance().General.getLastSelectedDir(),
+                                                          tr("Search Results (*.nqqsearch);;All files (*)"));
+    if (fileName.isEmpty())
+        return;
+
+    SearchConfig cfg;
+    SearchResult result;
+    QString error;
+
+    if (!SearchResultFile::load(fileName, cfg, result, &error)) {
+        QMessageBox::warning(QApplication::activeWindow(), tr("Error"),
+                             tr("Error while trying to open %1: %2").arg(fileName, error), QMessageBox::Ok);
+        return;
+    }
+
+    cfg.targetWindow = m_mainWindow;
+    addSearchInstance(new SearchInstance(cfg, result));
+}
+
 
 void AdvancedSearchDock::showReplaceDialog(const SearchResult& filteredResults, const QString& replaceText) const
 {
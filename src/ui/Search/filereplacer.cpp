@@ -57,7 +57,9 @@ void FileReplacer::replaceAll(const DocResult& doc, QString& content, const QStr
 
     for (const auto& result : doc.results) {
 
-        int len = result.positionInFile - lastEnd;
+        const int matchStart = static_cast<int>(result.positionInFile);
+
+        int len = matchStart - lastEnd;
         if (len > 0) {
             chunks << copy.midRef(lastEnd, len);
             newLength += len;
@@ -75,10 +77,10 @@ void FileReplacer::replaceAll(const DocResult& doc, QString& content, const QStr
             }
 
             // backreference itself
-            len = result.regexMatch.capturedLength(backReference.num);
+            const MatchResult::Capture capture = result.captures.value(backReference.num);
+            len = capture.length;
             if (len > 0) {
-                chunks << copy.midRef(result.regexMatch.capturedStart(backReference.num),
-                                      len);
+                chunks << copy.midRef(static_cast<int>(capture.positionInFile), len);
                 newLength += len;
             }
 
@@ -92,7 +94,7 @@ void FileReplacer::replaceAll(const DocResult& doc, QString& content, const QStr
             newLength += len;
         }
 
-        lastEnd = result.positionInFile + result.matchLength;
+        lastEnd = matchStart + result.matchLength;
     }
 
     // 3. trailing string after the last match
@@ -2,8 +2,10 @@
 
 #include "include/Search/searchstring.h"
 #include "include/docengine.h"
+#include "ote/Highlighter/regexengine.h"
 
 #include <QDirIterator>
+#include <QTextCodec>
 
 #include <algorithm>
 #include <vector>
@@ -32,9 +34,6 @@ bool matchesWholeWord(int index, int matchLength, const QString &data)
     return true;
 }
 
-/**
- * @brief getLinePositions Returns a vector with the positions of all line beginnings of the given string.
- */
 std::vector<int> getLinePositions(const QString &data)
 {
     const int dataSize = data.size();
@@ -76,8 +75,30 @@ QString trimEnd(const QString& str) {
     return QString(begin,end-begin);
 }
 
+/**
+ * @brief fillCaptures Stores the positions of all capture groups of 'match' in 'result'. 'base' is the offset of
+ *                     the matched string from the beginning of the file.
+ */
+void fillCaptures(MatchResult& result, const QRegularExpressionMatch& match, int captureCount, qint64 base)
+{
+    if (captureCount == 0)
+        return;
+
+    result.captures.resize(captureCount + 1);
+    for (int i = 0; i <= captureCount; i++) {
+        MatchResult::Capture& capture = result.captures[i];
+        capture.positionInFile = base + match.capturedStart(i);
+        capture.length = match.capturedLength(i);
+    }
+}
+
 const int MatchResult::CUTOFF_LENGTH = 60;
 
+const qint64 FileSearcher::STREAMING_THRESHOLD = 16 * 1024 * 1024;
+
+// Number of bytes read at once by searchRegExpStreamed()
+const int STREAMING_CHUNK_SIZE = 1024 * 1024;
+
 FileSearcher::FileSearcher(const SearchConfig& config)
     : QThread(nullptr),
       m_searchConfig(config)
@@ -90,8 +111,6 @@ FileSearcher* FileSearcher::prepareAsyncSearch(const SearchConfig& config)
 
 QRegularExpression FileSearcher::createRegexFromConfig(const SearchConfig& config)
 {
-    QRegularExpression regex;
-
     const QFlags<QRegularExpression::PatternOption> options = config.matchCase ?
                 QRegularExpression::MultilineOption :
                 QRegularExpression::MultilineOption | QRegularExpression::CaseInsensitiveOption;
@@ -99,10 +118,7 @@ QRegularExpression FileSearcher::createRegexFromConfig(const SearchConfig& confi
     const QString regexString = config.matchWord ?
                 "\\b" + config.searchString + "\\b" : config.searchString;
 
-    regex.setPattern(regexString);
-    regex.setPatternOptions(options);
-
-    return regex;
+    return ote::RegexEngine::compile(regexString, options, config.regexBacktrackLimit);
 }
 
 DocResult FileSearcher::searchPlainText(const SearchConfig& config, const QString& content)
@@ -144,16 +160,22 @@ DocResult FileSearcher::searchPlainText(const SearchConfig& config, const QStrin
     return results;
 }
 
-DocResult FileSearcher::searchRegExp(const QRegularExpression& regex, const QString& content)
+DocResult FileSearcher::searchRegExp(const QRegularExpression& regex, const QString& content, int timeLimit)
 {
     DocResult results;
 
     int offset = 0;
     std::vector<int> linePosition = getLinePositions(content);
+    const int captureCount = regex.captureCount();
 
     QRegularExpressionMatch match;
+    ote::RegexEngine::MatchStatus status;
     for (;;) {
-        match = regex.match(content, offset);
+        match = ote::RegexEngine::match(regex, content, offset, QRegularExpression::NoMatchOption, &status, timeLimit);
+
+        // A match that completed but exceeded the time limit is still recorded before the search stops.
+        const bool stop = status != ote::RegexEngine::MatchOk;
+        results.aborted = stop;
 
         if (!match.hasMatch())
             break;
@@ -170,15 +192,210 @@ DocResult FileSearcher::searchRegExp(const QRegularExpression& regex, const QStr
         result.positionInFile = offset;
         result.positionInLine = offset - lineStart;
         result.matchLength = match.capturedLength();
-        result.regexMatch = match;
+        fillCaptures(result, match, captureCount, 0);
         results.results.push_back(result);
 
         // Advance at least by one to avoit infinite loops when capturing
         // empty expressions.
         offset += std::max(1, result.matchLength);
+
+        if (stop)
+            break;
     }
 
-    results.regexCaptureGroupCount = regex.captureCount();
+    results.regexCaptureGroupCount = captureCount;
+
+    return results;
+}
+
+bool FileSearcher::regexCanMatchNewline(const QString& pattern)
+{
+    const int length = pattern.length();
+
+    for (int i = 0; i < length; i++) {
+        const QChar c = pattern[i];
+
+        if (c == '\n' || c == '\r')
+            return true;
+
+        // Negated classes, including negated POSIX classes like [[:^alpha:]]
+        if (c == '[' && i+1 < length && pattern[i+1] == '^')
+            return true;
+
+        if (c == '[' && (pattern.midRef(i, 8) == "[:space:" || pattern.midRef(i, 8) == "[:cntrl:"
+                         || pattern.midRef(i, 3) == "[:^"))
+            return true;
+
+        // Option settings like (?s) or (?ms:...). Also triggers on (?-s), which is fine.
+        if (c == '(' && i+1 < length && pattern[i+1] == '?') {
+            for (int j = i+2; j < length && pattern[j].isLetter(); j++) {
+                if (pattern[j] == 's')
+                    return true;
+            }
+            continue;
+        }
+
+        if (c != '\\' || i+1 >= length)
+            continue;
+
+        const QChar e = pattern[++i];
+
+        switch (e.unicode()) {
+        case 'n': case 'r': case 'v': case 'R':   // Line breaks
+        case 's': case 'W': case 'D': case 'H':   // Classes that contain line breaks
+        case 'X': case 'C':                       // Any grapheme cluster/code unit
+        case 'p': case 'P':                       // Unicode properties, e.g. \p{Cc}
+        case 'x': case 'o': case 'c': case '0':   // Character codes, e.g. \x0a, \o{12}, \cJ, \012
+            return true;
+        case 'N':
+            // \N is "any character but a newline", \N{U+000A} is a code point
+            if (i+1 < length && pattern[i+1] == '{')
+                return true;
+            break;
+        default:
+            // \1 to \9 are back references, but something like \12 might be an octal character code
+            if (e.isDigit() && i+1 < length && pattern[i+1].isDigit())
+                return true;
+            break;
+        }
+    }
+
+    return false;
+}
+
+DocResult FileSearcher::searchRegExpStreamed(QFile& file)
+{
+    DocResult results;
+
+    if (!file.open(QFile::ReadOnly))
+        return results;
+
+    bool bom = false;
+    QTextCodec* codec = DocEngine::detectCodec(file.peek(65536), bom);
+    QScopedPointer<QTextDecoder> decoder(codec->makeDecoder());
+
+    const bool lineMode = !regexCanMatchNewline(ote::RegexEngine::pattern(m_regex));
+    const int maxMatchSpan = std::max(1, m_searchConfig.maxMatchSpan);
+    const int captureCount = m_regex.captureCount();
+
+    // Windows are cut inside of lines that are too long to be held at once. A match that runs into the end
+    // of the window is searched again once more of the file is read, until the window reaches this size.
+    const int maxWindow = static_cast<int>(std::max<qint64>(STREAMING_THRESHOLD, 2 * qint64(maxMatchSpan)));
+
+    QString buffer;         // The window that's currently searched
+    qint64 bufferStart = 0; // buffer[0]'s offset from the beginning of the file
+    int offset = 0;         // Position in buffer where the search continues
+
+    // Starts of the lines in buffer, found incrementally as the file is read. The first line may have
+    // started before the window, in which case its position is negative.
+    std::vector<int> lineStarts = {0};
+    int firstLine = 1;      // Line number of lineStarts[0]
+    int scanned = 0;        // Position in buffer up to which line breaks have been looked for
+    bool atEnd = false;
+
+    while (!atEnd && !m_wantToStop) {
+        buffer += decoder->toUnicode(file.read(STREAMING_CHUNK_SIZE));
+        atEnd = file.atEnd();
+
+        // A trailing \r might be followed by a \n in the next chunk, so it's only looked at with the next chunk.
+        const int scanEnd = atEnd ? buffer.size() : buffer.size() - 1;
+        for (; scanned < scanEnd; scanned++) {
+            const QChar c = buffer[scanned];
+            if (c == '\r' && scanned+1 < buffer.size() && buffer[scanned+1] == '\n') {
+                lineStarts.push_back(scanned+2);
+                scanned++;
+            } else if (c == '\r' || c == '\n') {
+                lineStarts.push_back(scanned+1);
+            }
+        }
+
+        // Only matches that start before 'limit' are accepted. Anything after it might change when more of
+        // the file is read, so it is searched again with the next window. In line mode no match can extend past
+        // the last complete line. Otherwise, matches must not be longer than maxMatchSpan.
+        int limit = buffer.size();
+        if (!atEnd) {
+            limit = buffer.size() - maxMatchSpan;
+            if (lineMode)
+                limit = std::max(limit, lineStarts.back());
+
+            if (limit <= offset)
+                continue;
+        }
+
+        QRegularExpressionMatch match;
+        ote::RegexEngine::MatchStatus status;
+        bool deferred = false;
+        while (offset < limit) {
+            match = ote::RegexEngine::match(m_regex, buffer, offset, QRegularExpression::NoMatchOption,
+                                            &status, m_searchConfig.regexTimeLimit);
+
+            // A match that completed but exceeded the time limit is still recorded before the search stops.
+            // If it isn't final yet, it's lost with the rest of the document.
+            const bool stop = status != ote::RegexEngine::MatchOk;
+            results.aborted = stop;
+
+            if (!match.hasMatch() || match.capturedStart() >= limit)
+                break;
+
+            offset = match.capturedStart();
+
+            // Greedy matches and assertions like $ stop at the end of the window, even though the text
+            // might continue. Search again with more of the file, unless the window can't grow anymore.
+            if (!atEnd && match.capturedEnd() == buffer.size() && buffer.size() < maxWindow) {
+                deferred = true;
+                break;
+            }
+
+            const auto it = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+            const int line = std::distance(lineStarts.begin(), it) - 1;
+            const int lineStart = lineStarts[line];
+            const int lineEnd = line+1 < static_cast<int>(lineStarts.size()) ? lineStarts[line+1] : buffer.size();
+
+            // Lines longer than the window only keep the text around the match.
+            const int textStart = std::max({0, lineStart, offset - maxMatchSpan});
+            const int textEnd = std::min(lineEnd, match.capturedEnd() + maxMatchSpan);
+
+            MatchResult result;
+            result.lineNumber = firstLine + line;
+            result.matchLineString = trimEnd(buffer.mid(textStart, textEnd-textStart));
+            result.lineOffset = textStart - lineStart;
+            result.positionInFile = bufferStart + offset;
+            result.positionInLine = offset - lineStart;
+            result.matchLength = match.capturedLength();
+            fillCaptures(result, match, captureCount, bufferStart);
+            results.results.push_back(result);
+
+            offset += std::max(1, result.matchLength);
+
+            if (stop)
+                break;
+        }
+
+        if (atEnd || results.aborted)
+            break;
+
+        // Drop everything before the line the search continues in. The line itself is kept so lookbehinds
+        // and the result's matchLineString see all of it, but at most maxMatchSpan characters of it.
+        // At least one character is kept: \A would match at the start of the window otherwise.
+        if (!deferred)
+            offset = std::max(offset, limit);
+        const auto it = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+        const int skippedLines = std::distance(lineStarts.begin(), it) - 1;
+        const int cut = std::max(0, std::min(std::max(lineStarts[skippedLines], offset - maxMatchSpan), offset - 1));
+
+        buffer.remove(0, cut);
+        bufferStart += cut;
+        offset -= cut;
+        scanned -= cut;
+        firstLine += skippedLines;
+        lineStarts.erase(lineStarts.begin(), lineStarts.begin() + skippedLines);
+        for (int& pos : lineStarts)
+            pos -= cut;
+    }
+
+    file.close();
+
+    results.regexCaptureGroupCount = captureCount;
 
     return results;
 }
@@ -219,26 +436,34 @@ void FileSearcher::run() {
             emit resultProgress(count, listSize);
 
         QFile f(fileName);
-        DocEngine::DecodedText decodedText;
-        decodedText = DocEngine::readToString(&f);
-        f.close();
+        DocResult res;
 
-        if (decodedText.error) {
-            // File could not be read. We'll ignore this error since it should never happen. QDirIterator only iterates over
-            // readable files and DocEngine only reads the file. But if it happens we can skip the rest, just in case.
-            continue;
+        if (m_searchConfig.searchMode == SearchConfig::ModeRegex && f.size() > STREAMING_THRESHOLD) {
+            res = searchRegExpStreamed(f);
+        } else {
+            DocEngine::DecodedText decodedText;
+            decodedText = DocEngine::readToString(&f);
+            f.close();
+
+            if (decodedText.error) {
+                // File could not be read. We'll ignore this error since it should never happen. QDirIterator only iterates over
+                // readable files and DocEngine only reads the file. But if it happens we can skip the rest, just in case.
+                continue;
+            }
+
+            switch (m_searchConfig.searchMode) {
+            case SearchConfig::ModePlainText:
+            case SearchConfig::ModePlainTextSpecialChars:
+                res = searchPlainText(m_searchConfig, decodedText.text);
+                break;
+            case SearchConfig::ModeRegex:
+                res = searchRegExp(m_regex, decodedText.text, m_searchConfig.regexTimeLimit);
+                break;
+            }
         }
 
-        DocResult res;
-        switch (m_searchConfig.searchMode) {
-        case SearchConfig::ModePlainText:
-        case SearchConfig::ModePlainTextSpecialChars:
-            res = searchPlainText(m_searchConfig, decodedText.text);
-            break;
-        case SearchConfig::ModeRegex:
-            res = searchRegExp(m_regex, decodedText.text);
-            break;
-        }
+        if (res.aborted)
+            m_searchResult.abortedDocuments << fileName;
 
         if (!res.results.empty()) {
             res.docType = DocResult::TypeFile;
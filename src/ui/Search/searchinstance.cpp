@@ -1,11 +1,13 @@
 #include "include/Search/searchinstance.h"
 
 #include "include/EditorNS/editor.h"
+#include "include/iconprovider.h"
 #include "include/mainwindow.h"
 
 #include <QAbstractTextDocumentLayout>
 #include <QApplication>
 #include <QClipboard>
+#include <QFile>
 #include <QHeaderView>
 #include <QMenu>
 #include <QPainter>
@@ -101,12 +103,109 @@ public:
     }
 };
 
+void FilePrefetcher::run()
+{
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    // The data is discarded, reading it is enough to have the OS cache it.
+    const qint64 chunkSize = 1024 * 1024;
+    QByteArray buffer(static_cast<int>(chunkSize), Qt::Uninitialized);
+    while (!isInterruptionRequested() && file.read(buffer.data(), chunkSize) > 0) {}
+}
+
 SearchInstance::SearchInstance(const SearchConfig& config)
     : QObject(nullptr),
       m_searchConfig(config),
       m_treeWidget(new QTreeWidget())
+{
+    setupTreeWidget();
+    QTreeWidget* treeWidget = getResultTreeWidget();
+
+    // If we're searching through documents we'll just do the search right now. File System searches are
+    // delegated to a FileSearcher instance because they can take a while to finish.
+    if (config.searchScope == SearchConfig::ScopeCurrentDocument ||
+            config.searchScope == SearchConfig::ScopeAllOpenDocuments) {
+
+        // This is a mess because Nqq's Editor management is a mess.
+        // We'll grab all Editors that want to be searched, then search them one-by-one and add the results
+        // to our SearchResult instance.
+        std::vector<Editor*> editorsToSearch;
+
+        MainWindow* mw = config.targetWindow;
+        TopEditorContainer* tec = mw->topEditorContainer();
+
+        if (config.searchScope == SearchConfig::ScopeCurrentDocument)
+            editorsToSearch.push_back( mw->currentEditor() );
+        else
+            editorsToSearch = tec->getOpenEditors();
+
+        if (config.searchMode == SearchConfig::ModePlainText ||
+            config.searchMode == SearchConfig::ModePlainTextSpecialChars) {
+            for(Editor* ed : editorsToSearch) {
+                DocResult dr = FileSearcher::searchPlainText(config, ed->value());
+                dr.docType = DocResult::TypeDocument;
+                dr.fileName = tec->tabWidgetFromEditor(ed)->tabTextFromEditor(ed);
+                dr.editor = ed;
+                if (!dr.results.empty())
+                    m_searchResult.results.push_back(dr);
+            }
+        } else if (config.searchMode == SearchConfig::ModeRegex) {
+            QRegularExpression regex = FileSearcher::createRegexFromConfig(config);
+            for(Editor* ed : editorsToSearch) {
+                DocResult dr = FileSearcher::searchRegExp(regex, ed->value(), config.regexTimeLimit);
+                dr.docType = DocResult::TypeDocument;
+                dr.fileName = tec->tabWidgetFromEditor(ed)->tabTextFromEditor(ed);
+                dr.editor = ed;
+                if (dr.aborted)
+                    m_searchResult.abortedDocuments << dr.fileName;
+                if (!dr.results.empty())
+                    m_searchResult.results.push_back(dr);
+            }
+        }
+        onSearchCompleted();
+    } else if (config.searchScope == SearchConfig::ScopeFileSystem) {
+        QTreeWidgetItem* toplevelitem = new QTreeWidgetItem(treeWidget);
+        toplevelitem->setText(0, tr("Calculating..."));
+
+        m_fileSearcher = FileSearcher::prepareAsyncSearch(config);
+        connect(m_fileSearcher, &FileSearcher::resultProgress, this, &SearchInstance::onSearchProgress);
+        connect(m_fileSearcher, &FileSearcher::resultReady, this, &SearchInstance::onSearchCompleted);
+        connect(m_fileSearcher, &FileSearcher::finished, m_fileSearcher, &FileSearcher::deleteLater);
+        connect(m_fileSearcher, &FileSearcher::finished, this, [this]() {
+            // 'this' may be deleted during fileSearcher's lifetime, so this needs its own signal connection.
+            m_fileSearcher = nullptr;
+        });
+
+        m_fileSearcher->start();
+    }
+}
+
+SearchInstance::~SearchInstance()
+{
+    // After canceling, m_fileSearcher is deleted through a signal connected in SearchInstance's constructor
+    if (m_fileSearcher) m_fileSearcher->cancel();
+
+    // The prefetcher deletes itself when it's done
+    if (m_prefetcher) m_prefetcher->requestInterruption();
+}
+
+SearchInstance::SearchInstance(const SearchConfig& config, const SearchResult& result)
+    : QObject(nullptr),
+      m_isReadOnly(true),
+      m_searchConfig(config),
+      m_treeWidget(new QTreeWidget()),
+      m_searchResult(result)
+{
+    setupTreeWidget();
+    onSearchCompleted();
+}
+
+void SearchInstance::setupTreeWidget()
 {
     QTreeWidget* treeWidget = getResultTreeWidget();
+    const SearchConfig& config = m_searchConfig;
 
     QString searchLocation;
 
@@ -185,68 +284,6 @@ SearchInstance::SearchInstance(const SearchConfig& config)
         localPos.setY(localPos.y() + treeWidget->header()->height());
         m_contextMenu->exec( localPos );
     });
-
-    // If we're searching through documents we'll just do the search right now. File System searches are
-    // delegated to a FileSearcher instance because they can take a while to finish.
-    if (config.searchScope == SearchConfig::ScopeCurrentDocument ||
-            config.searchScope == SearchConfig::ScopeAllOpenDocuments) {
-
-        // This is a mess because Nqq's Editor management is a mess.
-        // We'll grab all Editors that want to be searched, then search them one-by-one and add the results
-        // to our SearchResult instance.
-        std::vector<Editor*> editorsToSearch;
-
-        MainWindow* mw = config.targetWindow;
-        TopEditorContainer* tec = mw->topEditorContainer();
-
-        if (config.searchScope == SearchConfig::ScopeCurrentDocument)
-            editorsToSearch.push_back( mw->currentEditor() );
-        else
-            editorsToSearch = tec->getOpenEditors();
-
-        if (config.searchMode == SearchConfig::ModePlainText ||
-            config.searchMode == SearchConfig::ModePlainTextSpecialChars) {
-            for(Editor* ed : editorsToSearch) {
-                DocResult dr = FileSearcher::searchPlainText(config, ed->value());
-                dr.docType = DocResult::TypeDocument;
-                dr.fileName = tec->tabWidgetFromEditor(ed)->tabTextFromEditor(ed);
-                dr.editor = ed;
-                if (!dr.results.empty())
-                    m_searchResult.results.push_back(dr);
-            }
-        } else if (config.searchMode == SearchConfig::ModeRegex) {
-            QRegularExpression regex = FileSearcher::createRegexFromConfig(config);
-            for(Editor* ed : editorsToSearch) {
-                DocResult dr = FileSearcher::searchRegExp(regex, ed->value());
-                dr.docType = DocResult::TypeDocument;
-                dr.fileName = tec->tabWidgetFromEditor(ed)->tabTextFromEditor(ed);
-                dr.editor = ed;
-                if (!dr.results.empty())
-                    m_searchResult.results.push_back(dr);
-            }
-        }
-        onSearchCompleted();
-    } else if (config.searchScope == SearchConfig::ScopeFileSystem) {
-        QTreeWidgetItem* toplevelitem = new QTreeWidgetItem(treeWidget);
-        toplevelitem->setText(0, tr("Calculating..."));
-
-        m_fileSearcher = FileSearcher::prepareAsyncSearch(config);
-        connect(m_fileSearcher, &FileSearcher::resultProgress, this, &SearchInstance::onSearchProgress);
-        connect(m_fileSearcher, &FileSearcher::resultReady, this, &SearchInstance::onSearchCompleted);
-        connect(m_fileSearcher, &FileSearcher::finished, m_fileSearcher, &FileSearcher::deleteLater);
-        connect(m_fileSearcher, &FileSearcher::finished, this, [this]() {
-            // 'this' may be deleted during fileSearcher's lifetime, so this needs its own signal connection.
-            m_fileSearcher = nullptr;
-        });
-
-        m_fileSearcher->start();
-    }
-}
-
-SearchInstance::~SearchInstance()
-{
-    // After canceling, m_fileSearcher is deleted through a signal connected in SearchInstance's constructor
-    if (m_fileSearcher) m_fileSearcher->cancel();
 }
 
 SearchResult SearchInstance::getFilteredSearchResult() const
@@ -304,61 +341,68 @@ void SearchInstance::collapseAllResults()
 
 void SearchInstance::selectNextResult()
 {
-    QTreeWidget* treeWidget = getResultTreeWidget();
+    if (m_resultList.empty())
+        return;
 
-    QTreeWidgetItem* curr = treeWidget->currentItem();
-    QTreeWidgetItem* next = nullptr;
-
-    if (!curr)
-        next = treeWidget->topLevelItem(0)->child(0);
-    else if (!curr->parent()) {
-        next = curr->child(0);
-    } else {
-        QTreeWidgetItem* top = curr->parent();
-        int nextIndex = top->indexOfChild(curr) + 1;
-
-        if (nextIndex < top->childCount())
-            next = top->child(nextIndex);
-        else {
-            int nextTop = treeWidget->indexOfTopLevelItem(top) + 1;
-            if (nextTop >= treeWidget->topLevelItemCount())
-                nextTop = 0;
-            next = treeWidget->topLevelItem(nextTop)->child(0);
-        }
-    }
+    const QTreeWidgetItem* curr = m_treeWidget->currentItem();
+    const int count = static_cast<int>(m_resultList.size());
+    int next = 0;
 
-    treeWidget->setCurrentItem(next);
-    emit treeWidget->doubleClicked(treeWidget->currentIndex());
+    // Every item stores the index of its (first) result in m_resultList, so no tree traversal is needed.
+    if (curr && !curr->parent())
+        next = curr->data(0, Qt::UserRole).toInt();
+    else if (curr)
+        next = (curr->data(0, Qt::UserRole).toInt() + 1) % count;
+
+    selectResult(next);
 }
 
 void SearchInstance::selectPreviousResult()
 {
-    QTreeWidget* treeWidget = getResultTreeWidget();
+    if (m_resultList.empty())
+        return;
 
-    QTreeWidgetItem* curr = treeWidget->currentItem();
-    QTreeWidgetItem* prev = nullptr;
-
-    if (!curr) {
-        QTreeWidgetItem* lastTop = treeWidget->topLevelItem(treeWidget->topLevelItemCount()-1);
-        prev = lastTop->child(lastTop->childCount()-1);
-    } else if (!curr->parent()) {
-        prev = curr->child(curr->childCount()-1);
-    } else {
-        QTreeWidgetItem* top = curr->parent();
-        int prevIndex = top->indexOfChild(curr) - 1;
-
-        if (prevIndex >= 0)
-            prev = top->child(prevIndex);
-        else {
-            int prevTop = treeWidget->indexOfTopLevelItem(top) - 1;
-            if (prevTop < 0)
-                prevTop = treeWidget->topLevelItemCount() - 1;
-            prev = treeWidget->topLevelItem(prevTop)->child(treeWidget->topLevelItem(prevTop)->childCount()-1);
-        }
-    }
+    const QTreeWidgetItem* curr = m_treeWidget->currentItem();
+    const int count = static_cast<int>(m_resultList.size());
+    int prev = count - 1;
+
+    if (curr && !curr->parent())
+        prev = curr->data(0, Qt::UserRole).toInt() + curr->childCount() - 1;
+    else if (curr)
+        prev = (curr->data(0, Qt::UserRole).toInt() - 1 + count) % count;
+
+    selectResult(prev);
+}
+
+void SearchInstance::selectResult(int index)
+{
+    if (index < 0 || index >= static_cast<int>(m_resultList.size()))
+        return;
+
+    const ResultEntry& entry = m_resultList[static_cast<size_t>(index)];
 
-    treeWidget->setCurrentItem(prev);
-    emit treeWidget->doubleClicked(treeWidget->currentIndex());
+    m_treeWidget->setCurrentItem(entry.item);
+    emit itemInteracted(*entry.doc, entry.result, SearchUserInteraction::OpenDocument);
+
+    // Stepping through the results usually continues into the next file. Start reading it now so it's
+    // already in the OS's file cache when it's opened.
+    // The document's top level item holds the index of its first result.
+    const size_t nextDoc = static_cast<size_t>(entry.item->parent()->data(0, Qt::UserRole).toInt()) +
+                           entry.doc->results.size();
+
+    if (nextDoc < m_resultList.size() && m_resultList[nextDoc].doc->docType == DocResult::TypeFile)
+        prefetchFile(m_resultList[nextDoc].doc->fileName);
+}
+
+void SearchInstance::prefetchFile(const QString& fileName)
+{
+    if (fileName == m_prefetchedFile || m_prefetcher)
+        return;
+
+    m_prefetchedFile = fileName;
+    m_prefetcher = new FilePrefetcher(fileName);
+    connect(m_prefetcher.data(), &QThread::finished, m_prefetcher.data(), &QObject::deleteLater);
+    m_prefetcher->start(QThread::LowPriority);
 }
 
 void SearchInstance::copySelectedLinesToClipboard() const
@@ -399,19 +443,37 @@ void SearchInstance::onSearchCompleted()
     }
 
     m_treeWidget->clear();
+    m_docMap.clear();
+    m_resultMap.clear();
+    m_resultList.clear();
+    m_resultList.reserve(static_cast<size_t>(m_searchResult.countResults()));
+
     for (const auto& doc : m_searchResult.results) {
         QTreeWidgetItem* toplevelitem = new QTreeWidgetItem(getResultTreeWidget());
         toplevelitem->setText(0, getFormattedLocationText(doc, m_searchConfig.directory));
         toplevelitem->setCheckState(0, Qt::Checked);
+        toplevelitem->setData(0, Qt::UserRole, static_cast<int>(m_resultList.size()));
         m_docMap[toplevelitem] = &doc;
 
         for (const auto& res : doc.results) {
             QTreeWidgetItem* it = new QTreeWidgetItem(toplevelitem);
             it->setText(0, getFormattedResultText(res, m_showFullLines));
             it->setCheckState(0, Qt::Checked);
+            it->setData(0, Qt::UserRole, static_cast<int>(m_resultList.size()));
             m_resultMap[it] = &res;
+            m_resultList.push_back({it, &doc, &res});
         }
     }
 
+    // Let the user know if the regex was too expensive to finish searching some documents
+    if (!m_searchResult.abortedDocuments.isEmpty()) {
+        QTreeWidgetItem* header = m_treeWidget->headerItem();
+        header->setIcon(0, IconProvider::fromTheme("dialog-warning"));
+        header->setText(0, header->text(0) + "  " +
+                        tr("(Search aborted in %1 document(s): the regular expression exceeded its "
+                           "backtracking or time limit)").arg(m_searchResult.abortedDocuments.size()));
+        header->setToolTip(0, m_searchResult.abortedDocuments.join('\n'));
+    }
+
     emit searchCompleted();
 }
@@ -15,22 +15,24 @@ QString SearchConfig::getScopeAsString() const {
 }
 
 QString MatchResult::getMatchString() const {
-    return matchLineString.mid(positionInLine, matchLength);
+    return matchLineString.mid(positionInLine - lineOffset, matchLength);
 }
 
 QString MatchResult::getPreMatchString(bool fullText) const {
-    const int pos = positionInLine;
+    const int pos = positionInLine - lineOffset;
 
     // Cut off part of the text if it is too long and the caller did not request full text
     if (!fullText && pos > CUTOFF_LENGTH)
         return "..." + matchLineString.mid( std::max(0, pos-CUTOFF_LENGTH), std::min(CUTOFF_LENGTH, pos) );
+    else if (lineOffset > 0)
+        return "..." + matchLineString.left(pos);
     else
         return matchLineString.left(pos);
 }
 
 QString MatchResult::getPostMatchString(bool fullText) const {
     const int end = matchLineString.length();
-    const int pos = positionInLine + matchLength;
+    const int pos = positionInLine - lineOffset + matchLength;
 
     if (!fullText && end-pos > CUTOFF_LENGTH)
         return matchLineString.mid(pos, CUTOFF_LENGTH) + "...";
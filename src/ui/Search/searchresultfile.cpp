@@ -0,0 +1,444 @@
+#include "include/Search/searchresultfile.h"
+
+#include <QFile>
+#include <QObject>
+#include <QSet>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char MAGIC[8] = {'N', 'Q', 'Q', 'S', 'R', 'E', 'S', '\0'};
+const quint32 VERSION = 2;
+
+// Value of MatchRecord::firstCapture for matches without capture groups
+const quint32 NO_CAPTURES = 0xffffffff;
+
+// Sizes in bytes of the header and of each record type
+const int HEADER_SIZE = 128;
+const int DOC_RECORD_SIZE = 32;
+const int LINE_RECORD_SIZE = 16;
+const int MATCH_RECORD_SIZE = 32;
+const int CAPTURE_RECORD_SIZE = 16;
+
+// Byte offsets of the header fields. A string reference is a 64 bit offset into the string table
+// followed by a 32 bit length and 32 bits of padding, both offset and length in UTF-16 code units.
+enum HeaderField {
+    HeaderMagic         = 0,    // char[8]
+    HeaderVersion       = 8,    // u32
+    HeaderFlags         = 12,   // u32: bit 0 matchCase, bit 1 matchWord, bit 2 includeSubdirs,
+                                //      bits 8-15 searchScope, bits 16-23 searchMode
+    HeaderDocCount      = 16,   // u32
+    HeaderLineCount     = 20,   // u32
+    HeaderMatchCount    = 24,   // u32
+    HeaderCaptureCount  = 28,   // u32
+    HeaderStringTable   = 32,   // u64 offsets of each section from the beginning of the file
+    HeaderDocTable      = 40,
+    HeaderLineTable     = 48,
+    HeaderMatchTable    = 56,
+    HeaderCaptureTable  = 64,
+    HeaderSearchString  = 72,   // string reference
+    HeaderDirectory     = 88,   // string reference
+    HeaderFilePattern   = 104   // string reference
+};
+
+// Record layouts, byte offsets in brackets:
+//   Doc:     [0] u64 name offset, [8] u32 name length, [12] u32 first match, [16] u32 match count,
+//            [20] u32 regex capture group count, [24] u32 flags (bit 0 aborted, bits 8-15 docType), [28] padding.
+//            Only aborted documents may have no matches; they're listed in SearchResult::abortedDocuments only.
+//   Line:    [0] u64 text offset, [8] u32 text length, [12] u32 line number
+//   Match:   [0] i64 position in file, [8] u32 line index, [12] i32 position in line, [16] i32 match length,
+//            [20] u32 first capture or NO_CAPTURES, [24] i32 position of the line's text in the line, non-zero
+//            for excerpts of long lines, [28] padding. Each match has (capture group count + 1) captures.
+//   Capture: [0] i64 position in file, [8] i32 length, [12] padding
+
+void put32(QByteArray& out, quint32 value)
+{
+    uchar bytes[4];
+    qToLittleEndian<quint32>(value, bytes);
+    out.append(reinterpret_cast<const char*>(bytes), 4);
+}
+
+void put64(QByteArray& out, quint64 value)
+{
+    uchar bytes[8];
+    qToLittleEndian<quint64>(value, bytes);
+    out.append(reinterpret_cast<const char*>(bytes), 8);
+}
+
+quint32 get32(const uchar* data)
+{
+    return qFromLittleEndian<quint32>(data);
+}
+
+quint64 get64(const uchar* data)
+{
+    return qFromLittleEndian<quint64>(data);
+}
+
+/**
+ * @brief The StringTable class writes UTF-16LE strings to a file and keeps track of their offsets.
+ */
+class StringTable {
+public:
+    StringTable(QIODevice* out) : m_out(out) {}
+
+    /**
+     * @brief add Writes 'str' and returns its offset from the beginning of the table in UTF-16 code units.
+     */
+    quint64 add(const QString& str) {
+        const quint64 offset = m_size;
+        const int length = str.length();
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        m_ok &= m_out->write(reinterpret_cast<const char*>(str.utf16()), length * 2) == length * 2;
+#else
+        QByteArray bytes(length * 2, Qt::Uninitialized);
+        for (int i = 0; i < length; i++)
+            qToLittleEndian<quint16>(str.at(i).unicode(), reinterpret_cast<uchar*>(bytes.data() + i * 2));
+        m_ok &= m_out->write(bytes) == bytes.size();
+#endif
+
+        m_size += length;
+        return offset;
+    }
+
+    quint64 sizeInBytes() const { return m_size * 2; }
+    bool isOk() const { return m_ok; }
+
+private:
+    QIODevice* m_out;
+    quint64 m_size = 0;
+    bool m_ok = true;
+};
+
+/**
+ * @brief The MappedFile struct gives bounds-checked access to the sections of a memory-mapped result file.
+ */
+struct MappedFile {
+    const uchar* data;
+    quint64 size;
+    quint64 stringTable;
+    quint64 stringTableEnd;
+
+    bool isInBounds(quint64 offset, quint64 count, quint64 recordSize) const {
+        return offset <= size && count <= (size - offset) / recordSize;
+    }
+
+    bool readString(const uchar* ref, QString& out) const {
+        const quint64 offset = get64(ref);
+        const quint32 length = get32(ref + 8);
+        const quint64 stringTableUnits = (stringTableEnd - stringTable) / 2;
+
+        if (offset > stringTableUnits || length > stringTableUnits - offset)
+            return false;
+
+        const uchar* begin = data + stringTable + offset * 2;
+        out.resize(static_cast<int>(length));
+        for (quint32 i = 0; i < length; i++)
+            out[static_cast<int>(i)] = QChar(qFromLittleEndian<quint16>(begin + i * 2));
+
+        return true;
+    }
+};
+
+} // namespace
+
+bool SearchResultFile::save(const QString& fileName, const SearchConfig& config, const SearchResult& result)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    // The header is written last, when all offsets are known.
+    QByteArray header(HEADER_SIZE, '\0');
+    bool ok = file.write(header) == HEADER_SIZE;
+
+    StringTable strings(&file);
+    QByteArray docTable;
+    QByteArray lineTable;
+    QByteArray matchTable;
+    QByteArray captureTable;
+    quint32 lineCount = 0;
+    quint32 matchCount = 0;
+    quint32 captureCount = 0;
+
+    const auto putString = [&strings](QByteArray& out, const QString& str) {
+        put64(out, strings.add(str));
+        put32(out, static_cast<quint32>(str.length()));
+        put32(out, 0);
+    };
+
+    QByteArray configStrings;
+    putString(configStrings, config.searchString);
+    putString(configStrings, config.directory);
+    putString(configStrings, config.filePattern);
+
+    for (const DocResult& doc : result.results) {
+        const int captureGroups = doc.regexCaptureGroupCount;
+
+        put64(docTable, strings.add(doc.fileName));
+        put32(docTable, static_cast<quint32>(doc.fileName.length()));
+        put32(docTable, matchCount);
+        put32(docTable, static_cast<quint32>(doc.results.size()));
+        put32(docTable, static_cast<quint32>(captureGroups));
+        put32(docTable, (doc.aborted ? 1u : 0u) | (static_cast<quint32>(doc.docType) << 8));
+        put32(docTable, 0);
+
+        // Matches are ordered by position, so all matches of a line follow each other.
+        // Excerpts of a long line differ between matches and are stored separately.
+        int previousLine = -1;
+        int previousLineOffset = -1;
+        for (const MatchResult& match : doc.results) {
+            if (match.lineNumber != previousLine || match.lineOffset != previousLineOffset) {
+                put64(lineTable, strings.add(match.matchLineString));
+                put32(lineTable, static_cast<quint32>(match.matchLineString.length()));
+                put32(lineTable, static_cast<quint32>(match.lineNumber));
+                previousLine = match.lineNumber;
+                previousLineOffset = match.lineOffset;
+                lineCount++;
+            }
+
+            put64(matchTable, static_cast<quint64>(match.positionInFile));
+            put32(matchTable, lineCount - 1);
+            put32(matchTable, static_cast<quint32>(match.positionInLine));
+            put32(matchTable, static_cast<quint32>(match.matchLength));
+
+            if (match.captures.isEmpty()) {
+                put32(matchTable, NO_CAPTURES);
+            } else {
+                put32(matchTable, captureCount);
+                for (int i = 0; i <= captureGroups; i++) {
+                    const MatchResult::Capture capture = match.captures.value(i);
+                    put64(captureTable, static_cast<quint64>(capture.positionInFile));
+                    put32(captureTable, static_cast<quint32>(capture.length));
+                    put32(captureTable, 0);
+                }
+                captureCount += static_cast<quint32>(captureGroups + 1);
+            }
+            put32(matchTable, static_cast<quint32>(match.lineOffset));
+            put32(matchTable, 0);
+
+            matchCount++;
+        }
+    }
+
+    // Documents aborted before their first match only appear in abortedDocuments. They are stored as
+    // records without matches, so the warning about them survives a round trip.
+    QSet<QString> writtenDocs;
+    for (const DocResult& doc : result.results)
+        writtenDocs.insert(doc.fileName);
+
+    quint32 docCount = static_cast<quint32>(result.results.size());
+    for (const QString& fileName : result.abortedDocuments) {
+        if (writtenDocs.contains(fileName))
+            continue;
+
+        put64(docTable, strings.add(fileName));
+        put32(docTable, static_cast<quint32>(fileName.length()));
+        put32(docTable, matchCount);
+        put32(docTable, 0);
+        put32(docTable, 0);
+        put32(docTable, 1u | (static_cast<quint32>(DocResult::TypeFile) << 8));
+        put32(docTable, 0);
+        docCount++;
+    }
+
+    // Pad the string table so the following tables are 8-byte aligned
+    const quint64 stringTableEnd = HEADER_SIZE + strings.sizeInBytes();
+    const int padding = static_cast<int>((8 - stringTableEnd % 8) % 8);
+    ok = ok && file.write(QByteArray(padding, '\0')) == padding;
+
+    const quint64 docTableOffset = stringTableEnd + padding;
+    const quint64 lineTableOffset = docTableOffset + docTable.size();
+    const quint64 matchTableOffset = lineTableOffset + lineTable.size();
+    const quint64 captureTableOffset = matchTableOffset + matchTable.size();
+
+    ok = ok && strings.isOk();
+    ok = ok && file.write(docTable) == docTable.size();
+    ok = ok && file.write(lineTable) == lineTable.size();
+    ok = ok && file.write(matchTable) == matchTable.size();
+    ok = ok && file.write(captureTable) == captureTable.size();
+
+    header.clear();
+    header.append(MAGIC, 8);
+    put32(header, VERSION);
+    put32(header, (config.matchCase ? 1u : 0u) | (config.matchWord ? 2u : 0u) | (config.includeSubdirs ? 4u : 0u) |
+                  (static_cast<quint32>(config.searchScope) << 8) | (static_cast<quint32>(config.searchMode) << 16));
+    put32(header, docCount);
+    put32(header, lineCount);
+    put32(header, matchCount);
+    put32(header, captureCount);
+    put64(header, HEADER_SIZE);
+    put64(header, docTableOffset);
+    put64(header, lineTableOffset);
+    put64(header, matchTableOffset);
+    put64(header, captureTableOffset);
+    header.append(configStrings);
+    header.append(QByteArray(HEADER_SIZE - header.size(), '\0'));
+
+    ok = ok && file.seek(0) && file.write(header) == HEADER_SIZE;
+
+    file.close();
+    return ok;
+}
+
+bool SearchResultFile::load(const QString& fileName, SearchConfig& config, SearchResult& result, QString* errorString)
+{
+    const auto fail = [errorString](const QString& message) {
+        if (errorString)
+            *errorString = message;
+        return false;
+    };
+
+    const QString invalidFile = QObject::tr("The file is not a valid search result file.");
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(file.errorString());
+
+    const qint64 fileSize = file.size();
+    if (fileSize < HEADER_SIZE)
+        return fail(invalidFile);
+
+    const uchar* data = file.map(0, fileSize);
+    if (!data)
+        return fail(file.errorString());
+
+    if (std::memcmp(data + HeaderMagic, MAGIC, 8) != 0)
+        return fail(invalidFile);
+
+    if (get32(data + HeaderVersion) != VERSION)
+        return fail(QObject::tr("The search result file was created by an incompatible version of Notepadqq."));
+
+    MappedFile f;
+    f.data = data;
+    f.size = static_cast<quint64>(fileSize);
+    f.stringTable = get64(data + HeaderStringTable);
+    f.stringTableEnd = get64(data + HeaderDocTable);
+
+    const quint32 flags = get32(data + HeaderFlags);
+    const quint32 docCount = get32(data + HeaderDocCount);
+    const quint32 lineCount = get32(data + HeaderLineCount);
+    const quint32 matchCount = get32(data + HeaderMatchCount);
+    const quint32 captureCount = get32(data + HeaderCaptureCount);
+    const uchar* docTable = data + f.stringTableEnd;
+    const quint64 lineTableOffset = get64(data + HeaderLineTable);
+    const quint64 matchTableOffset = get64(data + HeaderMatchTable);
+    const quint64 captureTableOffset = get64(data + HeaderCaptureTable);
+
+    if (f.stringTable < HEADER_SIZE || f.stringTable > f.stringTableEnd
+            || !f.isInBounds(f.stringTableEnd, docCount, DOC_RECORD_SIZE)
+            || !f.isInBounds(lineTableOffset, lineCount, LINE_RECORD_SIZE)
+            || !f.isInBounds(matchTableOffset, matchCount, MATCH_RECORD_SIZE)
+            || !f.isInBounds(captureTableOffset, captureCount, CAPTURE_RECORD_SIZE))
+        return fail(invalidFile);
+
+    SearchConfig cfg;
+    if (!f.readString(data + HeaderSearchString, cfg.searchString)
+            || !f.readString(data + HeaderDirectory, cfg.directory)
+            || !f.readString(data + HeaderFilePattern, cfg.filePattern))
+        return fail(invalidFile);
+
+    cfg.matchCase = flags & 1;
+    cfg.matchWord = flags & 2;
+    cfg.includeSubdirs = flags & 4;
+    cfg.setScopeFromInt(static_cast<int>((flags >> 8) & 0xff));
+    const int mode = static_cast<int>((flags >> 16) & 0xff);
+    if (mode <= SearchConfig::ModeRegex)
+        cfg.searchMode = static_cast<SearchConfig::SearchMode>(mode);
+
+    // Each line's text is only read once. The matches on a line share the string.
+    QVector<QString> lines(static_cast<int>(lineCount));
+    QVector<int> lineNumbers(static_cast<int>(lineCount));
+    for (quint32 i = 0; i < lineCount; i++) {
+        const uchar* record = data + lineTableOffset + quint64(i) * LINE_RECORD_SIZE;
+        if (!f.readString(record, lines[static_cast<int>(i)]))
+            return fail(invalidFile);
+        lineNumbers[static_cast<int>(i)] = static_cast<int>(get32(record + 12));
+    }
+
+    SearchResult res;
+    res.results.reserve(static_cast<int>(docCount));
+
+    for (quint32 d = 0; d < docCount; d++) {
+        const uchar* record = docTable + quint64(d) * DOC_RECORD_SIZE;
+        const quint32 firstMatch = get32(record + 12);
+        const quint32 docMatchCount = get32(record + 16);
+        const quint32 docFlags = get32(record + 24);
+
+        DocResult doc;
+        if (!f.readString(record, doc.fileName) || firstMatch > matchCount || docMatchCount > matchCount - firstMatch)
+            return fail(invalidFile);
+
+        doc.regexCaptureGroupCount = static_cast<int>(get32(record + 20));
+        doc.aborted = docFlags & 1;
+        doc.docType = ((docFlags >> 8) & 0xff) == DocResult::TypeFile ? DocResult::TypeFile : DocResult::TypeNone;
+        doc.results.reserve(static_cast<int>(docMatchCount));
+
+        if (doc.aborted)
+            res.abortedDocuments << doc.fileName;
+
+        // Only documents whose search was aborted are stored without matches. They are not results.
+        if (docMatchCount == 0) {
+            if (!doc.aborted)
+                return fail(invalidFile);
+            continue;
+        }
+
+        const quint32 capturesPerMatch = get32(record + 20) + 1;
+
+        for (quint32 m = firstMatch; m < firstMatch + docMatchCount; m++) {
+            const uchar* matchRecord = data + matchTableOffset + quint64(m) * MATCH_RECORD_SIZE;
+            const quint32 lineIndex = get32(matchRecord + 8);
+            const quint32 firstCapture = get32(matchRecord + 20);
+
+            if (lineIndex >= lineCount)
+                return fail(invalidFile);
+
+            MatchResult match;
+            match.positionInFile = static_cast<qint64>(get64(matchRecord));
+            match.matchLineString = lines[static_cast<int>(lineIndex)];
+            match.lineNumber = lineNumbers[static_cast<int>(lineIndex)];
+            match.positionInLine = static_cast<int>(get32(matchRecord + 12));
+            match.matchLength = static_cast<int>(get32(matchRecord + 16));
+            match.lineOffset = static_cast<int>(get32(matchRecord + 24));
+
+            const qint64 positionInText = qint64(match.positionInLine) - match.lineOffset;
+            if (match.positionInFile < 0 || match.lineOffset < 0 || match.matchLength < 0
+                    || positionInText < 0 || positionInText > match.matchLineString.length())
+                return fail(invalidFile);
+
+            // Lines are stored without trailing whitespace and regex matches may continue on the following
+            // lines, so a match can be longer than the rest of its line. Only the part on the line is kept.
+            match.matchLength = std::min(match.matchLength, match.matchLineString.length() - static_cast<int>(positionInText));
+
+            if (firstCapture != NO_CAPTURES) {
+                if (firstCapture > captureCount || capturesPerMatch > captureCount - firstCapture)
+                    return fail(invalidFile);
+
+                match.captures.resize(static_cast<int>(capturesPerMatch));
+                for (quint32 c = 0; c < capturesPerMatch; c++) {
+                    const uchar* captureRecord = data + captureTableOffset + quint64(firstCapture + c) * CAPTURE_RECORD_SIZE;
+                    MatchResult::Capture& capture = match.captures[static_cast<int>(c)];
+                    capture.positionInFile = static_cast<qint64>(get64(captureRecord));
+                    capture.length = static_cast<int>(get32(captureRecord + 8));
+
+                    // Lookarounds can capture text outside of the match, so captures are only checked for sanity
+                    if (capture.positionInFile < 0 || capture.length < 0)
+                        return fail(invalidFile);
+                }
+            }
+
+            doc.results.push_back(match);
+        }
+
+        res.results.push_back(doc);
+    }
+
+    config = cfg;
+    result = std::move(res);
+    return true;
+}
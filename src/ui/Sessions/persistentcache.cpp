@@ -17,6 +17,11 @@ QString PersistentCache::backupDirPath() {
     return path;
 }
 
+QString PersistentCache::syntaxCacheDirPath() {
+    static QString path = QFileInfo(QSettings().fileName()).dir().absolutePath().append("/syntaxCache");
+    return path;
+}
+
 QUrl PersistentCache::createValidCacheName(const QDir& parent, const QString &fileName)
 {
     QUrl cacheFile;
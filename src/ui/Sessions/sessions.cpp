@@ -361,6 +361,32 @@ bool saveSession(DocEngine* docEngine, TopEditorContainer* editorContainer, QStr
     return true;
 }
 
+QStringList sessionLanguages(QString sessionPath)
+{
+    QFile file(sessionPath);
+    if (!file.open(QIODevice::ReadOnly))
+        return QStringList();
+
+    SessionReader reader(file);
+
+    bool success = false;
+    const auto& views = reader.readData(&success);
+    if (!success)
+        return QStringList();
+
+    QStringList active;
+    QStringList others;
+    for (const auto& view : views) {
+        for (const TabData& tab : view.tabs) {
+            if (tab.language.isEmpty() || active.contains(tab.language) || others.contains(tab.language))
+                continue;
+            (tab.active ? active : others).append(tab.language);
+        }
+    }
+
+    return active + others;
+}
+
 void loadSession(DocEngine* docEngine, TopEditorContainer* editorContainer, QString sessionPath)
 {
     QFile file(sessionPath);
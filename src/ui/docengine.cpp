@@ -614,7 +614,8 @@ void DocEngine::documentChanged(QString fileName)
 void DocEngine::closeDocument(EditorTabWidget *tabWidget, int tab)
 {
     Editor *editor = tabWidget->editor(tab);
-    unmonitorDocument(editor);
+    if (!editor->isDocumentShared())
+        unmonitorDocument(editor);
     tabWidget->removeTab(tab);
 }
 
@@ -634,22 +635,21 @@ bool DocEngine::isMonitored(Editor *editor)
     return m_fsWatcher->files().contains(editor->filePath().toLocalFile());
 }
 
-DocEngine::DecodedText DocEngine::decodeText(const QByteArray &contents)
+QTextCodec *DocEngine::detectCodec(const QByteArray &head, bool &hasBom)
 {
     // Search for a BOM mark
-    QTextCodec *bomCodec = QTextCodec::codecForUtfText(contents, nullptr);
-    if (bomCodec != nullptr) {
-        return decodeText(contents, bomCodec, true);
+    QTextCodec *codec = QTextCodec::codecForUtfText(head, nullptr);
+    hasBom = codec != nullptr;
+    if (hasBom) {
+        return codec;
     }
 
-    QTextCodec* codec = nullptr;
-
     // Limit decoding to the first 64 kilobytes
-    size_t detectionSize = static_cast<size_t>(std::min(contents.size(), 65536));
+    size_t detectionSize = static_cast<size_t>(std::min(head.size(), 65536));
 
     // Use uchardet to try and detect file encoding if no BOM was found
     uchardet_t encodingDetector = uchardet_new();
-    if (uchardet_handle_data(encodingDetector, contents.data(), detectionSize) == 0) {
+    if (uchardet_handle_data(encodingDetector, head.data(), detectionSize) == 0) {
         uchardet_data_end(encodingDetector);
         codec = QTextCodec::codecForName(uchardet_get_charset(encodingDetector));
         uchardet_delete(encodingDetector);
@@ -660,6 +660,18 @@ DocEngine::DecodedText DocEngine::decodeText(const QByteArray &contents)
         codec = QTextCodec::codecForName("UTF-8");
     }
 
+    return codec;
+}
+
+DocEngine::DecodedText DocEngine::decodeText(const QByteArray &contents)
+{
+    bool bom = false;
+    QTextCodec *codec = detectCodec(contents, bom);
+
+    if (bom) {
+        return decodeText(contents, codec, true);
+    }
+
     DecodedText bestDecodedText;
     bestDecodedText.codec = codec;
     bestDecodedText.text = codec->toUnicode(contents);
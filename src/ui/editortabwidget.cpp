@@ -112,13 +112,18 @@ int EditorTabWidget::transferEditorTab(bool setFocus, EditorTabWidget *source, i
     return this->rawAddEditorTab(setFocus, QString(), source, tabIndex);
 }
 
+int EditorTabWidget::cloneEditorTab(bool setFocus, EditorTabWidget *source, int tabIndex)
+{
+    return this->rawAddEditorTab(setFocus, QString(), source, tabIndex, true);
+}
+
 /**
  * @brief Do NOT directly connect to Editor signals within this method,
  *        or they'll remain attached to this EditorTabWidget whenever the
  *        tab gets moved to another container. Use connectEditorSignals()
  *        and disconnectEditorSignals() methods instead.
  */
-int EditorTabWidget::rawAddEditorTab(const bool setFocus, const QString &title, EditorTabWidget *source, const int sourceTabIndex)
+int EditorTabWidget::rawAddEditorTab(const bool setFocus, const QString &title, EditorTabWidget *source, const int sourceTabIndex, const bool clone)
 {
 #ifdef QT_DEBUG
     QElapsedTimer __aet_timer;
@@ -138,7 +143,8 @@ int EditorTabWidget::rawAddEditorTab(const bool setFocus, const QString &title,
     if (create) {
         editor = Editor::getNewEditor(this);
     } else {
-        editor = source->editorSharedPtr(sourceTabIndex);
+        editor = clone ? Editor::getClonedEditor(source->editor(sourceTabIndex), this)
+                       : source->editorSharedPtr(sourceTabIndex);
 
         oldText = source->tabText(sourceTabIndex);
         oldIcon = source->tabIcon(sourceTabIndex);
@@ -153,7 +159,7 @@ int EditorTabWidget::rawAddEditorTab(const bool setFocus, const QString &title,
     editor->setTabName(tabTitle);
     int index = addTab(editor.data(), tabTitle);
 
-    if (!create) {
+    if (!create && !clone) {
         source->disconnectEditorSignals(editor.data());
     }
     this->connectEditorSignals(editor.data());
@@ -11,6 +11,8 @@
 #include <QUrl>
 #include <QPrinter>
 
+#include <memory>
+#include <vector>
 
 namespace ote {
 class TextEdit;
@@ -30,10 +32,25 @@ namespace EditorNS
     public:
 
         explicit Editor(QWidget *parent = 0);
+        ~Editor();
 
         static QSharedPointer<Editor> getNewEditor(QWidget *parent = 0);
         static Editor *getNewEditorUnmanagedPtr(QWidget *parent);
 
+        /**
+         * @brief Creates a second view of the document shown by \p source.
+         *        Both editors share the text, undo history and syntax
+         *        highlighting, but have their own cursors and scroll positions.
+         *        The file path is kept in sync between them. The encoding, line
+         *        endings, indentation mode and language are shared as well.
+         */
+        static QSharedPointer<Editor> getClonedEditor(Editor *source, QWidget *parent = 0);
+
+        /**
+         * @brief Returns whether other editors show the same document.
+         */
+        bool isDocumentShared() const;
+
         struct Cursor {
             int line;
             int column;
@@ -242,18 +259,28 @@ namespace EditorNS
 
         QUrl m_filePath = QUrl();
         QString m_tabName;
-        bool m_fileOnDiskChanged = false;
         bool m_loaded = false;
-        QString m_endOfLineSequence = "\n";
-        QTextCodec *m_codec = QTextCodec::codecForName("UTF-8");
-        bool m_bom = false;
-        bool m_customIndentationMode = false;
 
-        void fullConstructor(const ote::Theme& theme);
+        // State of the document rather than of the view, shared by all editors showing it
+        struct SharedState {
+            bool fileOnDiskChanged = false;
+            QString endOfLineSequence = "\n";
+            QTextCodec *codec = QTextCodec::codecForName("UTF-8");
+            bool bom = false;
+            bool customIndentationMode = false;
+            std::vector<Editor*> editors;
+        };
+        std::shared_ptr<SharedState> m_shared;
+
+        Editor(Editor *source, QWidget *parent);
+        void fullConstructor(const ote::Theme& theme, const ote::Definition& language);
 
         void setIndentationMode(const bool useTabs, const int size);
         void setIndentationMode(const ote::Definition& def);
 
+        // Same as setIndentationMode() for all editors showing the document
+        void setSharedIndentationMode(const bool useTabs, const int size);
+
     signals:
         void gotFocus();
         void mouseWheel(QWheelEvent *ev);
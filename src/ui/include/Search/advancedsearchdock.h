@@ -101,6 +101,21 @@ private:
      */
     void showReplaceDialog(const SearchResult& filteredResults, const QString& replaceText) const;
 
+    /**
+     * @brief addSearchInstance Takes ownership of the given SearchInstance, adds it to the search history and displays it.
+     */
+    void addSearchInstance(SearchInstance* instance);
+
+    /**
+     * @brief exportResults Asks for a file name and saves the current SearchInstance's results to it.
+     */
+    void exportResults();
+
+    /**
+     * @brief openResults Asks for a file previously written by exportResults() and adds its results to the history.
+     */
+    void openResults();
+
     void onChangeSearchScope(int index);
     void onCurrentSearchInstanceCompleted();
     void onUserInput();
@@ -130,6 +145,7 @@ private:
 
     // Left-hand titlebar items
     QToolButton* m_btnClearHistory;
+    QToolButton* m_btnOpenResults;
     QComboBox*   m_cmbSearchHistory;
     QToolButton* m_btnMoreOptions;
     QToolButton* m_btnPrevResult;
@@ -164,6 +180,7 @@ private:
     QAction* m_actRedoSearch;
     QAction* m_actCopyContents;
     QAction* m_actShowFullLines;
+    QAction* m_actExportResults;
     QAction* m_actRemoveSearch;
 
     QVBoxLayout* m_titlebarLayout;
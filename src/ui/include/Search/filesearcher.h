@@ -4,10 +4,19 @@
 #include "searchhelpers.h"
 #include "searchobjects.h"
 
+#include <QFile>
 #include <QObject>
 #include <QRegularExpression>
 #include <QThread>
 
+#include <vector>
+
+/**
+ * @brief getLinePositions Returns a vector with the positions of all line beginnings of the given string.
+ *                         The last item is always the string's size.
+ */
+std::vector<int> getLinePositions(const QString& data);
+
 /**
  * @brief The FileSearcher class contains the tools to search strings and files asynchronously and synchronously.
  *        Use prepareAsyncSearch() and run start() on the returned FileSearcher* object to search files
@@ -26,7 +35,8 @@ public:
 
     /**
      * @brief createRegexFromConfig Creates a RegularExpression based on the given config that can be used
-     *                              in conjuncture with searchRegExp()
+     *                              in conjuncture with searchRegExp(). It is compiled through ote::RegexEngine,
+     *                              so use ote::RegexEngine::pattern() to get the pattern back.
      */
     static QRegularExpression createRegexFromConfig(const SearchConfig& config);
 
@@ -42,9 +52,25 @@ public:
      * @brief searchRegExp  Searches a given string via a RegularExpression (synchronously)
      * @param regex The RegExp to be used. Can be created  via createRegexFromString()
      * @param content The string to be searched
-     * @return A DocResult containing all found matches.
+     * @param timeLimit If a single match takes longer than this many milliseconds, the search is aborted.
+     *                  0 disables the limit.
+     * @return A DocResult containing all found matches. If the regex exceeded its limits, DocResult::aborted
+     *         is set and the matches found so far are returned.
+     */
+    static DocResult searchRegExp(const QRegularExpression& regex, const QString& content, int timeLimit = 0);
+
+    /**
+     * @brief regexCanMatchNewline Returns true if the given pattern might match a line break. The check is
+     *                             conservative: it may return true for patterns that never do, but never false
+     *                             for patterns that can.
+     */
+    static bool regexCanMatchNewline(const QString& pattern);
+
+    /**
+     * @brief STREAMING_THRESHOLD Files larger than this (in bytes) are not loaded at once for regex searches but
+     *                            scanned in overlapping windows. See SearchConfig::maxMatchSpan.
      */
-    static DocResult searchRegExp(const QRegularExpression& regex, const QString& content);
+    static const qint64 STREAMING_THRESHOLD;
 
     /**
      * @brief cancel Orders the FileSearcher to stop searching at the earliest convenience. Won't immediately stop.
@@ -71,6 +97,14 @@ protected:
 private:
     FileSearcher(const SearchConfig& config);
 
+    /**
+     * @brief searchRegExpStreamed Searches a file with m_regex without holding all of its contents in memory.
+     *                             Patterns that can't match a line break are searched in line-aligned windows.
+     *                             Other patterns, and lines too long to be held at once, are searched in windows
+     *                             overlapping by maxMatchSpan characters.
+     */
+    DocResult searchRegExpStreamed(QFile& file);
+
     SearchConfig m_searchConfig;
     QRegularExpression m_regex;
     bool m_wantToStop = false;
@@ -5,12 +5,30 @@
 #include "searchobjects.h"
 
 #include <QObject>
+#include <QPointer>
 #include <QScopedPointer>
 #include <QString>
+#include <QThread>
 #include <QTreeWidget>
 
 #include <map>
 #include <memory>
+#include <vector>
+
+/**
+ * @brief The FilePrefetcher class reads a file in the background and discards its contents, so that
+ *        opening it afterwards is served from the OS's file cache.
+ */
+class FilePrefetcher : public QThread {
+public:
+    FilePrefetcher(const QString& fileName) : m_fileName(fileName) {}
+
+protected:
+    void run() override;
+
+private:
+    QString m_fileName;
+};
 
 /**
  * @brief The SearchInstance class contains all the data that represents a search, including the
@@ -29,6 +47,13 @@ public:
      *               be started, but searching documents is fast enough not to visibly block the UI.
      */
     SearchInstance(const SearchConfig& config);
+
+    /**
+     * @brief SearchInstance Constructs SearchInstance object that displays an existing search result,
+     *                       e.g. one loaded through SearchResultFile. No search is started and the
+     *                       instance is read-only, see isReadOnly().
+     */
+    SearchInstance(const SearchConfig& config, const SearchResult& result);
     ~SearchInstance();
 
     /**
@@ -46,6 +71,13 @@ public:
      */
     bool isSearchInProgress() const { return m_isSearchInProgress; }
 
+    /**
+     * @brief isReadOnly Returns true if the results weren't produced by this instance's search, e.g. because
+     *                   they were loaded from a file. Their positions may not match the files anymore, so they
+     *                   must not be used for replacing, nor be searched again.
+     */
+    bool isReadOnly() const { return m_isReadOnly; }
+
     QTreeWidget*        getResultTreeWidget() const { return m_treeWidget.data(); }
     const SearchConfig& getSearchConfig() const { return m_searchConfig; }
     const SearchResult& getSearchResult() const { return m_searchResult; }
@@ -78,12 +110,25 @@ signals:
     void itemInteracted(const DocResult& doc, const MatchResult* result, SearchUserInteraction type);
 
 private:
+    /**
+     * @brief setupTreeWidget Sets up the tree widget's header, delegate and context menu. Called in the constructors.
+     */
+    void setupTreeWidget();
+
+    /**
+     * @brief selectResult Selects the result at 'index' in m_resultList, opens it and prefetches the
+     *                     file containing the following result. Does nothing if 'index' is out of range.
+     */
+    void selectResult(int index);
+    void prefetchFile(const QString& fileName);
+
     void onSearchProgress(int processed, int total);
     void onSearchCompleted();
 
     bool m_isSearchInProgress = true; // Search is started in the constructor so it can default to true
     bool m_resultsAreExpanded = false;
     bool m_showFullLines = false;
+    bool m_isReadOnly = false;
 
     SearchConfig                m_searchConfig;
     QScopedPointer<QTreeWidget> m_treeWidget;
@@ -99,6 +144,18 @@ private:
     // These map each QTreeWidget item to their respective MatchResult or DocResult
     std::map<QTreeWidgetItem*, const MatchResult*>  m_resultMap;
     std::map<QTreeWidgetItem*, const DocResult*>    m_docMap;
+
+    // All MatchResults in display order. Each tree item stores the index of its (first) entry as
+    // Qt::UserRole data, so stepping through results doesn't need to search the tree.
+    struct ResultEntry {
+        QTreeWidgetItem*    item;
+        const DocResult*    doc;
+        const MatchResult*  result;
+    };
+    std::vector<ResultEntry>    m_resultList;
+
+    QPointer<FilePrefetcher>    m_prefetcher;
+    QString                     m_prefetchedFile;
 };
 
 
@@ -4,8 +4,8 @@
 #include "include/Search/searchhelpers.h"
 
 #include <QObject>
-#include <QRegularExpressionMatch>
 #include <QString>
+#include <QStringList>
 #include <QVector>
 
 class MainWindow;
@@ -32,6 +32,16 @@ struct SearchConfig {
     bool matchWord      = false;
     bool includeSubdirs = false; // Only used if searchMode==ScopeFileSystem.
 
+    // Only used for regex searches in ScopeFileSystem. Large files are scanned in overlapping windows
+    // instead of being loaded at once; a match spanning multiple lines may be at most this many characters long.
+    int maxMatchSpan = 64 * 1024;
+
+    // Only used if searchMode==ModeRegex. A regex that backtracks more often than regexBacktrackLimit
+    // or takes longer than regexTimeLimit milliseconds for a single match aborts the document's search.
+    // A regexBacktrackLimit of -1 uses ote::RegexEngine's default, a regexTimeLimit of 0 disables the time limit.
+    int regexBacktrackLimit = -1;
+    int regexTimeLimit = 0;
+
     enum SearchScope {
         ScopeCurrentDocument    = 0,
         ScopeAllOpenDocuments   = 1,
@@ -65,12 +75,19 @@ struct MatchResult {
      */
     QString getPostMatchString(bool fullText=false) const;
 
-    QString matchLineString; // The full text line where the match occured
+    struct Capture {
+        qint64 positionInFile = 0; // The captured text's offset from the beginning of the file
+        int length = 0;            // The captured text's length. 0 if the group did not participate in the match
+    };
+
+    QString matchLineString; // The full text line where the match occured. Only an excerpt for very long lines
+    int lineOffset = 0;      // Position of matchLineString in the line, non-zero if it's an excerpt
     int lineNumber;          // The line number, starting at 1
-    int positionInFile;      // The match's offset from the beginning of the file
+    qint64 positionInFile;   // The match's offset from the beginning of the file
     int positionInLine;      // The match's offset from the beginning of the line
     int matchLength;         // The match's length
-    QRegularExpressionMatch regexMatch; // Only valid if this MatchResult was created by a regex search
+    QVector<Capture> captures; // Capture groups, index 0 is the whole match. Only filled by regex searches
+                               // whose expression has capture groups
 
 private:
     static const int CUTOFF_LENGTH; //Number of characters before/after match result that will be shown in preview
@@ -91,6 +108,7 @@ struct DocResult {
     QString fileName;                   // Is a file path when docType==TypeFile and a file name when TypeDocument
     QVector<MatchResult> results;
     int regexCaptureGroupCount = 0;     // Only used when DocResult was created by a regex search
+    bool aborted = false;               // True if the regex exceeded its limits. 'results' may be incomplete.
 };
 
 enum class SearchUserInteraction {
@@ -106,6 +124,7 @@ struct SearchResult {
     int countResults() const;
 
     QVector<DocResult> results;
+    QStringList abortedDocuments; // Names of all documents whose search was aborted, see DocResult::aborted
 };
 
 
@@ -0,0 +1,41 @@
+#ifndef SEARCHRESULTFILE_H
+#define SEARCHRESULTFILE_H
+
+#include "searchobjects.h"
+
+#include <QString>
+
+/**
+ * @brief The SearchResultFile class saves SearchResults to and loads them from a compact binary file, so that
+ *        large results can be kept, shared and reopened without searching again.
+ *
+ *        All numbers are little-endian and all sections are 8-byte aligned, so the file can be memory-mapped.
+ *        The file consists of:
+ *          - A header with the search parameters, the number of items in each table and their offsets
+ *          - A string table holding UTF-16 text: the search parameters, file names and line texts
+ *          - A table of fixed-width document records
+ *          - A table of fixed-width line records. A line with several matches is only stored once, unless
+ *            only excerpts of it are kept.
+ *          - A table of fixed-width match records
+ *          - A table of fixed-width capture group records (regex searches only)
+ */
+class SearchResultFile {
+public:
+    /**
+     * @brief save Writes the given search and its result to 'fileName'.
+     * @return True if successful.
+     */
+    static bool save(const QString& fileName, const SearchConfig& config, const SearchResult& result);
+
+    /**
+     * @brief load Reads a search and its result from 'fileName'. DocResults of TypeDocument are loaded as
+     *             TypeNone since their editors aren't available anymore. Every match is checked against its
+     *             line and its matchLength is limited to the rest of the line, the only part that's displayed.
+     * @param errorString Set to a human-readable description if loading fails.
+     * @return True if successful.
+     */
+    static bool load(const QString& fileName, SearchConfig& config, SearchResult& result,
+                     QString* errorString = nullptr);
+};
+
+#endif // SEARCHRESULTFILE_H
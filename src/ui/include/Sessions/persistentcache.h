@@ -22,6 +22,12 @@ public:
     */
     static QString backupDirPath();
 
+    /**
+     * @brief Returns the path to the directory that contains the precompiled
+     *        syntax definitions.
+     */
+    static QString syntaxCacheDirPath();
+
     /**
      * @brief Generates a QUrl to a file within the a directory.
      * @param parent The parent directory for the file.
@@ -2,6 +2,7 @@
 #define SESSIONS_H
 
 #include <QString>
+#include <QStringList>
 
 class DocEngine;
 class TopEditorContainer;
@@ -28,6 +29,14 @@ bool saveSession(DocEngine* docEngine, TopEditorContainer* editorContainer, QStr
  */
 void loadSession(DocEngine* docEngine, TopEditorContainer* editorContainer, QString sessionPath);
 
+/**
+ * @brief Reads the languages of the tabs stored in a session XML file without restoring
+ *        anything, e.g. to prepare their syntax definitions early.
+ * @param sessionPath Path to where the XML file is located.
+ * @return The language names, those of the active tabs first. Without duplicates.
+ */
+QStringList sessionLanguages(QString sessionPath);
+
 } // namespace Autosave
 
 #endif // SESSIONS_H
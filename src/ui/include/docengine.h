@@ -136,6 +136,15 @@ public:
     static DocEngine::DecodedText readToString(QFile *file, QTextCodec *codec, bool bom);
     static bool writeFromString(QIODevice *io, const DecodedText &write);
 
+    /**
+     * @brief Guesses the codec of a text from its first bytes. Looks for a BOM
+     *        first, then asks uchardet. Falls back to UTF-8.
+     * @param head The beginning of the text. Only the first 64 KiB are examined.
+     * @param hasBom Set to true if a BOM was found.
+     * @return
+     */
+    static QTextCodec *detectCodec(const QByteArray &head, bool &hasBom);
+
     /**
      * @brief Write the provided Editor content to the specified IO device, using
      *        the encoding and the BOM settings specified in the Editor.
@@ -28,6 +28,15 @@ public:
      * @return Tab index of the new document inside this EditorTabWidget.
      */
     int transferEditorTab(bool setFocus, EditorTabWidget *source, int tabIndex);
+    /**
+     * @brief Add a second view of a document shown in another EditorTabWidget.
+     *        The views share the same document, see Editor::getClonedEditor().
+     * @param setFocus True to give focus to the new view
+     * @param source EditorTabWidget that contains the source document
+     * @param tabIndex Tab index, inside \p source, of the document
+     * @return Tab index of the new view inside this EditorTabWidget.
+     */
+    int cloneEditorTab(bool setFocus, EditorTabWidget *source, int tabIndex);
     int findOpenEditorByUrl(const QUrl &filename);
     Editor *editor(int index) const;
     QSharedPointer<Editor> editorSharedPtr(int index);
@@ -93,7 +102,7 @@ private:
      * @param sourceTabIndex Tab index, within @param source, of the tab to transfer
      * @return Index of the tab
      */
-    int rawAddEditorTab(const bool setFocus, const QString &title, EditorTabWidget *source, const int sourceTabIndex);
+    int rawAddEditorTab(const bool setFocus, const QString &title, EditorTabWidget *source, const int sourceTabIndex, const bool clone = false);
 private slots:
     void on_cleanChanged(bool isClean); 
     void on_editorMouseWheel(QWheelEvent *ev);
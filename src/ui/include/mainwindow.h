@@ -12,6 +12,7 @@
 #include <QCloseEvent>
 #include <QLabel>
 #include <QMainWindow>
+#include <QPointer>
 
 #include <functional>
 
@@ -93,6 +94,7 @@ private slots:
     void on_actionNew_triggered();
     void on_customTabContextMenuRequested(QPoint point, EditorTabWidget *tabWidget, int tabIndex);
     void on_actionMove_to_Other_View_triggered();
+    void on_actionClone_to_Other_View_triggered();
     void on_actionOpen_triggered();
     void on_actionOpen_Folder_triggered();
     void on_tabCloseRequested(EditorTabWidget* tabWidget, int tab);
@@ -217,6 +219,7 @@ private:
     bool                  beginSelectPositionSet = false;
 
     AdvancedSearchDock*  m_advSearchDock;
+    QPointer<Editor>     m_lastSearchResultEditor; // Editor of the last file opened through the search dock
 
     /**
      * @brief saveTabsToCache Saves tabs to cache. Utilizes the saveSession function and
@@ -106,6 +106,9 @@ public:
         NQQ_SETTING(ReplaceHistory, QStringList,    QStringList())
         NQQ_SETTING(FileHistory,    QStringList,    QStringList())
         NQQ_SETTING(FilterHistory,  QStringList,    QStringList())
+        NQQ_SETTING(RegexMaxMatchSpan, int,         65536)   // In characters
+        NQQ_SETTING(RegexBacktrackLimit, int,       1000000)
+        NQQ_SETTING(RegexTimeLimit, int,            2000)    // In milliseconds
     END_CATEGORY(Search)
 
     BEGIN_CATEGORY(Extensions)
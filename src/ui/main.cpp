@@ -17,6 +17,7 @@
 #include <QLocale>
 #include <QObject>
 #include <QTranslator>
+#include <QVector>
 #include <QtGlobal>
 
 #include <unistd.h> // For getuid
@@ -105,9 +106,23 @@ int main(int argc, char *argv[])
         return EXIT_SUCCESS;
     }
 
-    ote::TextEdit::initRepository(Notepadqq::appDataPath("data"));
+    ote::TextEdit::initRepository(Notepadqq::appDataPath("data"), PersistentCache::syntaxCacheDirPath());
     enforceDefaultSettings();
 
+    // Prepare the syntax definitions that will likely be needed first in the background: those of the
+    // tabs that are about to be restored, then those of recently used documents.
+    {
+        auto& repo = ote::TextEdit::getRepository();
+        QVector<ote::Definition> defs;
+        if (settings.General.getRememberTabsOnExit()) {
+            for (const auto& language : Sessions::sessionLanguages(PersistentCache::cacheSessionPath()))
+                defs.push_back(repo.definitionForName(language));
+        }
+        for (const auto& recent : settings.General.getRecentDocuments())
+            defs.push_back(repo.definitionForFileName(recent.toUrl().fileName()));
+        repo.warmUp(defs);
+    }
+
 
     // Arguments received from another instance
     QObject::connect(&a, &SingleApplication::receivedArguments, &a, [=](const QString &workingDirectory, const QStringList &arguments) {
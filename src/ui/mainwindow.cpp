@@ -790,6 +790,14 @@ void MainWindow::on_actionMove_to_Other_View_triggered()
     removeTabWidgetIfEmpty(curTabWidget);
 }
 
+void MainWindow::on_actionClone_to_Other_View_triggered()
+{
+    EditorTabWidget *curTabWidget = m_topEditorContainer->currentTabWidget();
+    EditorTabWidget *destTabWidget = m_topEditorContainer->inactiveTabWidget(true);
+
+    destTabWidget->cloneEditorTab(true, curTabWidget, curTabWidget->currentIndex());
+}
+
 void MainWindow::removeTabWidgetIfEmpty(EditorTabWidget *tabWidget) {
     if(tabWidget->count() == 0) {
         delete tabWidget;
@@ -908,7 +916,9 @@ int MainWindow::closeTab(EditorTabWidget *tabWidget, int tab, bool remove, bool
         goto cleanup;
     }
 
-    if (force || editor->isClean() || (editor->filePath().isEmpty() && editor->value().isEmpty())) {
+    // Closing one of several views of a document doesn't lose any changes.
+    if (force || editor->isClean() || editor->isDocumentShared() ||
+            (editor->filePath().isEmpty() && editor->value().isEmpty())) {
         if (remove) m_docEngine->closeDocument(tabWidget, tab);
         goto cleanup;
     }
@@ -1264,20 +1274,34 @@ void MainWindow::searchDockItemInteracted(const DocResult& doc, const MatchResul
         found->setFocus();
 
     } else if (doc.docType == DocResult::TypeFile) {
-        // Check the file's existence before trying to open it through the DocEngine. that is needed because
-        // DocEngine will even open nonexistent documents and just show them as empty.
-        if (!QFile(doc.fileName).exists()) return;
+        const QUrl url = stringToUrl(doc.fileName);
+        Editor* editor = nullptr;
+        EditorTabWidget* tabWidget = nullptr;
+
+        // Stepping through search results mostly stays within the same file. Reuse its editor while it's
+        // still open instead of looking it up among all tabs and going through the DocEngine again.
+        if (m_lastSearchResultEditor && m_lastSearchResultEditor->filePath() == url)
+            tabWidget = m_topEditorContainer->tabWidgetFromEditor(m_lastSearchResultEditor);
+
+        if (tabWidget) {
+            editor = m_lastSearchResultEditor;
+            if (tabWidget->currentWidget() != editor)
+                tabWidget->setCurrentWidget(editor);
+        } else {
+            // Check the file's existence before trying to open it through the DocEngine. that is needed because
+            // DocEngine will even open nonexistent documents and just show them as empty.
+            if (!QFile(doc.fileName).exists()) return;
 
-        QUrl url = stringToUrl(doc.fileName);
+            m_docEngine->getDocumentLoader().setUrl(url).setTabWidget(m_topEditorContainer->currentTabWidget()).execute();
 
-        m_docEngine->getDocumentLoader().setUrl(url).setTabWidget(m_topEditorContainer->currentTabWidget()).execute();
+            QPair<int, int> pos = m_docEngine->findOpenEditorByUrl(url);
 
-        QPair<int, int> pos = m_docEngine->findOpenEditorByUrl(url);
+            if (pos.first == -1 || pos.second == -1)
+                return;
 
-        if (pos.first == -1 || pos.second == -1)
-            return;
-
-        Editor *editor = m_topEditorContainer->tabWidget(pos.first)->editor(pos.second);
+            editor = m_topEditorContainer->tabWidget(pos.first)->editor(pos.second);
+            m_lastSearchResultEditor = editor;
+        }
 
         if (result) {
             editor->setSelection(result->lineNumber-1, result->positionInLine, //selection start
@@ -5,15 +5,20 @@ DEFINES += QT_DEPRECATED_WARNINGS NO_STANDARD_PATHS
 
 SOURCES += \
     $$PWD/abstracthighlighter.cpp \
+    $$PWD/blockdata.cpp \
     $$PWD/context.cpp \
     $$PWD/contextswitch.cpp \
     $$PWD/definition.cpp \
     #$$PWD/definitiondownloader.cpp \
     $$PWD/fmtrangelist.cpp \
+    $$PWD/foldingindex.cpp \
     $$PWD/foldingregion.cpp \
     $$PWD/format.cpp \
+    $$PWD/highlightprofiler.cpp \
+    $$PWD/highlightworker.cpp \
     $$PWD/htmlhighlighter.cpp \
     $$PWD/keywordlist.cpp \
+    $$PWD/regexengine.cpp \
     $$PWD/repository.cpp \
     $$PWD/rule.cpp \
     $$PWD/state.cpp \
@@ -25,6 +30,7 @@ SOURCES += \
 HEADERS += \
     $$PWD/abstracthighlighter.h \
     $$PWD/abstracthighlighter_p.h \
+    $$PWD/blockdata_p.h \
     $$PWD/context_p.h \
     $$PWD/contextswitch_p.h \
     $$PWD/definition.h \
@@ -32,12 +38,17 @@ HEADERS += \
     #$$PWD/definitiondownloader.h \
     $$PWD/definitionref_p.h \
     $$PWD/fmtrangelist.h \
+    $$PWD/foldingindex_p.h \
     $$PWD/foldingregion.h \
     $$PWD/format.h \
     $$PWD/format_p.h \
+    $$PWD/highlightprofiler.h \
+    $$PWD/highlightprofiler_p.h \
+    $$PWD/highlightworker_p.h \
     $$PWD/htmlhighlighter.h \
     $$PWD/keywordlist_p.h \
     $$PWD/matchresult_p.h \
+    $$PWD/regexengine.h \
     $$PWD/repository.h \
     $$PWD/repository_p.h \
     $$PWD/rule_p.h \
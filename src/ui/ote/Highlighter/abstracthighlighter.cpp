@@ -28,6 +28,8 @@
 #include "definition_p.h"
 #include "foldingregion.h"
 #include "format.h"
+#include "highlightprofiler_p.h"
+#include "regexengine.h"
 #include "repository.h"
 #include "rule_p.h"
 #include "state.h"
@@ -35,6 +37,7 @@
 #include "theme.h"
 
 #include <QDebug>
+#include <QElapsedTimer>
 
 using namespace ote;
 
@@ -96,6 +99,44 @@ void AbstractHighlighter::setTheme(const Theme& theme)
     d->m_theme = theme;
 }
 
+namespace {
+
+/**
+ * Adds the profile of a line to the HighlightProfiler statistics when highlightLine() returns.
+ */
+class LineProfileScope
+{
+public:
+    explicit LineProfileScope(AbstractHighlighterPrivate* d)
+        : m_d(d)
+        , m_enabled(HighlightProfiler::isEnabled())
+    {
+        m_d->m_profiling = m_enabled;
+        if (m_enabled) {
+            m_d->m_profile.clear();
+            m_timer.start();
+        }
+    }
+
+    ~LineProfileScope()
+    {
+        if (m_enabled)
+            m_d->m_profile.commit(m_d->m_definition, m_d->m_skipOffsetBlocks, m_timer.nsecsElapsed());
+    }
+
+    bool isEnabled() const
+    {
+        return m_enabled;
+    }
+
+private:
+    AbstractHighlighterPrivate* m_d;
+    bool m_enabled;
+    QElapsedTimer m_timer;
+};
+
+}
+
 /**
  * Returns the index of the first non-space character. If the line is empty,
  * or only contains white spaces, text.size() is returned.
@@ -111,9 +152,40 @@ static inline int firstNonSpaceChar(const QString& text)
 }
 
 State AbstractHighlighter::highlightLine(const QString& text, const State& state)
+{
+    return highlightLine(text, state, 0, -1, -1, nullptr);
+}
+
+State AbstractHighlighter::lineEndState(const State& state)
 {
     Q_D(AbstractHighlighter);
 
+    auto newState = state;
+    if (!StateData::get(newState))
+        return newState;
+
+    const DefinitionRef currentDefRef(d->m_definition);
+    while (!StateData::get(newState)->context()->lineEndContext().isStay()) {
+        if (!d->switchContext(newState, StateData::get(newState)->context()->lineEndContext(), QStringList(), currentDefRef))
+            break;
+    }
+    return newState;
+}
+
+State AbstractHighlighter::highlightLine(const QString& text, const State& state, int startOffset, int maxOffset,
+                                         qint64 maxNsecs, int* stoppedAt)
+{
+    Q_D(AbstractHighlighter);
+
+    if (stoppedAt)
+        *stoppedAt = text.size();
+
+    /**
+     * skip offsets of the rules tried so far, see AbstractHighlighterPrivate::skipOffsetBase()
+     */
+    d->m_skipOffsets.clear();
+    d->m_skipOffsetBlocks.clear();
+
     // verify definition, deal with no highlighting being enabled
     d->ensureDefinitionLoaded();
     if (!d->m_definition.isValid()) {
@@ -121,39 +193,59 @@ State AbstractHighlighter::highlightLine(const QString& text, const State& state
         return State();
     }
 
+    const LineProfileScope profile(d);
+
     // verify/initialize state
     auto defData = DefinitionData::get(d->m_definition);
     auto newState = state;
-    auto stateData = StateData::get(newState);
     const DefinitionRef currentDefRef(d->m_definition);
-    if (!stateData->isEmpty() && (stateData->m_defRef != currentDefRef)) {
+    if (StateData::get(newState) && (StateData::get(newState)->definitionRef() != currentDefRef)) {
         qDebug() << "Got invalid state, resetting.";
-        stateData->clear();
-    }
-    if (stateData->isEmpty()) {
-        stateData->push(defData->initialContext(), QStringList());
-        stateData->m_defRef = currentDefRef;
+        StateData::clear(newState);
     }
+    if (!StateData::get(newState))
+        StateData::push(newState, defData->initialContext(), QStringList(), currentDefRef);
 
     // process empty lines
     if (text.isEmpty()) {
-        while (!stateData->topContext()->lineEmptyContext().isStay())
-            d->switchContext(stateData, stateData->topContext()->lineEmptyContext(), QStringList());
-        auto context = stateData->topContext();
+        while (!StateData::get(newState)->context()->lineEmptyContext().isStay())
+            d->switchContext(newState, StateData::get(newState)->context()->lineEmptyContext(), QStringList(), currentDefRef);
+        auto context = StateData::get(newState)->context();
         applyFormat(0, 0, context->attributeFormat());
         return newState;
     }
 
-    int offset = 0, beginOffset = 0;
+    Q_ASSERT(startOffset >= 0 && startOffset < text.size());
+    int offset = startOffset, beginOffset = startOffset;
     bool lineContinuation = false;
-    QHash<Rule*, int> skipOffsets;
+
+    /**
+     * budget for pathologically long lines, the clock is only checked every now and then
+     */
+    QElapsedTimer timer;
+    if (maxNsecs >= 0)
+        timer.start();
+    int steps = 0;
+
+    /**
+     * times each rule attempt if profiling
+     */
+    QElapsedTimer ruleTimer;
+
+    /**
+     * looked up once per line instead of on every regex match
+     */
+    RegExpr::setProfiling(RegexEngine::isProfilingEnabled());
+
+    const Context* skipContext = nullptr;
+    int skipBase = 0;
 
     /**
      * current active format
      * stored as pointer to avoid deconstruction/constructions inside the internal loop
      * the pointers are stable, the formats are either in the contexts or rules
      */
-    auto currentFormat = &stateData->topContext()->attributeFormat();
+    auto currentFormat = &StateData::get(newState)->context()->attributeFormat();
 
     /**
      * cached first non-space character, needs to be computed if < 0
@@ -169,10 +261,21 @@ State AbstractHighlighter::highlightLine(const QString& text, const State& state
          */
         const Format* newFormat = nullptr;
 
+        const auto stateData = StateData::get(newState);
+        const auto context = stateData->context();
+        if (context != skipContext) {
+            skipBase = d->skipOffsetBase(context);
+            skipContext = context;
+        }
+
         /**
-         * try to match all rules in the context in order of declaration in XML
+         * try to match all rules in the context that may start with the current character,
+         * in order of declaration in XML
          */
-        for (const auto& rule : stateData->topContext()->rules()) {
+        const auto& rules = context->rules();
+        for (const int slot : context->candidateRules(text.at(offset))) {
+            const auto& rule = rules[slot];
+
             /**
              * filter out rules that require a specific column
              */
@@ -205,18 +308,29 @@ State AbstractHighlighter::highlightLine(const QString& text, const State& state
              *   - rule can't match at all => currentSkipOffset < 0
              *   - rule will only match for some higher offset => currentSkipOffset > offset
              */
-            const auto currentSkipOffset = skipOffsets.value(rule.get());
+            auto& currentSkipOffset = d->m_skipOffsets[skipBase + slot];
             if (currentSkipOffset < 0 || currentSkipOffset > offset)
                 continue;
 
-            const auto newResult = rule->doMatch(text, offset, stateData->topCaptures());
+            if (profile.isEnabled())
+                ruleTimer.start();
+
+            const auto newResult = rule->doMatch(text, offset, stateData->captures());
             newOffset = newResult.offset();
 
+            if (profile.isEnabled()) {
+                auto& counters = d->m_profile.counters(skipBase + slot);
+                ++counters.attempts;
+                counters.nsecs += ruleTimer.nsecsElapsed();
+                if (newOffset > offset)
+                    ++counters.matches;
+            }
+
             /**
              * update skip offset if new one rules out any later match or is larger than current one
              */
             if (newResult.skipOffset() < 0 || newResult.skipOffset() > currentSkipOffset)
-                skipOffsets.insert(rule.get(), newResult.skipOffset());
+                currentSkipOffset = newResult.skipOffset();
 
             if (newOffset <= offset)
                 continue;
@@ -229,14 +343,14 @@ State AbstractHighlighter::highlightLine(const QString& text, const State& state
 
             if (rule->isLookAhead()) {
                 Q_ASSERT(!rule->context().isStay());
-                d->switchContext(stateData, rule->context(), newResult.captures());
+                d->switchContext(newState, rule->context(), newResult.captures(), currentDefRef);
                 isLookAhead = true;
                 break;
             }
 
-            d->switchContext(stateData, rule->context(), newResult.captures());
+            d->switchContext(newState, rule->context(), newResult.captures(), currentDefRef);
             newFormat = rule->attributeFormat().isValid() ? &rule->attributeFormat()
-                                                          : &stateData->topContext()->attributeFormat();
+                                                          : &StateData::get(newState)->context()->attributeFormat();
             if (newOffset == text.size() && std::dynamic_pointer_cast<LineContinue>(rule))
                 lineContinuation = true;
             break;
@@ -245,13 +359,13 @@ State AbstractHighlighter::highlightLine(const QString& text, const State& state
             continue;
 
         if (newOffset <= offset) { // no matching rule
-            if (stateData->topContext()->fallthrough()) {
-                d->switchContext(stateData, stateData->topContext()->fallthroughContext(), QStringList());
+            if (stateData->context()->fallthrough()) {
+                d->switchContext(newState, stateData->context()->fallthroughContext(), QStringList(), currentDefRef);
                 continue;
             }
 
             newOffset = offset + 1;
-            newFormat = &stateData->topContext()->attributeFormat();
+            newFormat = &stateData->context()->attributeFormat();
         }
 
         /**
@@ -275,35 +389,64 @@ State AbstractHighlighter::highlightLine(const QString& text, const State& state
         Q_ASSERT(newOffset > offset);
         offset = newOffset;
 
+        /**
+         * out of budget? the caller may continue from here with the returned state
+         */
+        if (offset < text.size() &&
+            ((maxOffset >= 0 && offset >= maxOffset) ||
+             (maxNsecs >= 0 && (++steps & 0x3ff) == 0 && timer.nsecsElapsed() > maxNsecs))) {
+            applyFormat(beginOffset, offset - beginOffset, *currentFormat);
+            if (stoppedAt)
+                *stoppedAt = offset;
+            return newState;
+        }
+
     } while (offset < text.size());
 
     if (beginOffset < offset)
         applyFormat(beginOffset, text.size() - beginOffset, *currentFormat);
 
-    while (!stateData->topContext()->lineEndContext().isStay() && !lineContinuation) {
-        if (!d->switchContext(stateData, stateData->topContext()->lineEndContext(), QStringList()))
+    while (!StateData::get(newState)->context()->lineEndContext().isStay() && !lineContinuation) {
+        if (!d->switchContext(newState, StateData::get(newState)->context()->lineEndContext(), QStringList(), currentDefRef))
             break;
     }
 
     return newState;
 }
 
+int AbstractHighlighterPrivate::skipOffsetBase(const Context* context)
+{
+    for (const auto& block : m_skipOffsetBlocks) {
+        if (block.first == context)
+            return block.second;
+    }
+
+    const int base = static_cast<int>(m_skipOffsets.size());
+    m_skipOffsets.resize(base + context->rules().size(), 0);
+    m_skipOffsetBlocks.emplace_back(context, base);
+    return base;
+}
+
 bool AbstractHighlighterPrivate::switchContext(
-    StateData* data, const ContextSwitch& contextSwitch, const QStringList& captures)
+    State& state, const ContextSwitch& contextSwitch, const QStringList& captures, const DefinitionRef& defRef)
 {
+    if (m_profiling)
+        ++m_profile.contextSwitches;
+
     for (int i = 0; i < contextSwitch.popCount(); ++i) {
+        const auto data = StateData::get(state);
         // don't pop the last context if we can't push one
-        if (data->size() == 1 && !contextSwitch.context())
+        if (data && data->size() == 1 && !contextSwitch.context())
             return false;
-        if (data->size() == 0)
+        if (!data)
             break;
-        data->pop();
+        StateData::pop(state);
     }
 
     if (contextSwitch.context())
-        data->push(contextSwitch.context(), captures);
+        StateData::push(state, contextSwitch.context(), captures, defRef);
 
-    Q_ASSERT(!data->isEmpty());
+    Q_ASSERT(StateData::get(state));
     return true;
 }
 
@@ -145,6 +145,31 @@ protected:
      */
     State highlightLine(const QString &text, const State &state);
 
+    /**
+     * Highlight the given line, or part of it, with a budget for pathologically
+     * long lines. Highlighting starts at @p offset, where @p state is the state
+     * of the highlighting engine at that offset, i.e. either the state of the
+     * previous line with @p offset 0, or a state returned by an earlier call
+     * that stopped early.
+     * @param maxOffset Highlighting stops once this offset has been reached,
+     *        -1 for no limit.
+     * @param maxNsecs Highlighting stops once this many nanoseconds have passed,
+     *        -1 for no limit.
+     * @param stoppedAt Receives the offset highlighting stopped at, which is
+     *        text.size() if the whole line has been highlighted.
+     * @returns The state after the line if it has been highlighted to its end,
+     *        or the state at @p stoppedAt otherwise. Use lineEndState() to get
+     *        an approximation of the state after such a line.
+     */
+    State highlightLine(const QString &text, const State &state, int offset, int maxOffset, qint64 maxNsecs,
+                        int *stoppedAt);
+
+    /**
+     * Returns the state after a line whose highlighting stopped with @p state,
+     * as if the rest of the line didn't contain anything to highlight.
+     */
+    State lineEndState(const State &state);
+
     /**
      * Reimplement this to apply formats to your output. The provided @p format
      * is valid for the interval [@p offset, @p offset + @p length).
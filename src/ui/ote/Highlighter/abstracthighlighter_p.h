@@ -25,14 +25,20 @@
 #define KSYNTAXHIGHLIGHTING_ABSTRACTHIGHLIGHTER_P_H
 
 #include "definition.h"
+#include "highlightprofiler_p.h"
 #include "theme.h"
 
+#include <utility>
+#include <vector>
+
 class QStringList;
 
 namespace ote {
 
+class Context;
 class ContextSwitch;
-class StateData;
+class DefinitionRef;
+class State;
 
 class AbstractHighlighterPrivate
 {
@@ -41,10 +47,27 @@ public:
     virtual ~AbstractHighlighterPrivate();
 
     void ensureDefinitionLoaded();
-    bool switchContext(StateData* data, const ContextSwitch &contextSwitch, const QStringList &captures);
+    bool switchContext(State &state, const ContextSwitch &contextSwitch, const QStringList &captures,
+                       const DefinitionRef &defRef);
+
+    /**
+     * Returns the index of @p context's block in m_skipOffsets, adding one if the context
+     * hasn't been visited in the current line yet. The block holds the skip offset of each
+     * of the context's rules, indexed like Context::rules().
+     */
+    int skipOffsetBase(const Context *context);
 
     Definition m_definition;
     Theme m_theme;
+
+    // per-line scratch buffers of highlightLine(), kept to avoid allocations
+    std::vector<int> m_skipOffsets;
+    std::vector<std::pair<const Context *, int>> m_skipOffsetBlocks;
+
+    // profile of the current line, only filled if HighlightProfiler::isEnabled() was true when the
+    // line started, see m_profiling
+    LineProfile m_profile;
+    bool m_profiling = false;
 };
 
 }
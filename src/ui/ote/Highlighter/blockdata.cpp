@@ -0,0 +1,185 @@
+#include "blockdata_p.h"
+
+#include "highlightworker_p.h"
+
+#include <map>
+#include <memory>
+#include <new>
+#include <set>
+#include <type_traits>
+
+namespace ote {
+
+namespace {
+
+// Number of blocks' data allocated at once when the pool runs empty
+const int CHUNK_SIZE = 1024;
+
+/**
+ * Allocates the blocks' data in chunks of CHUNK_SIZE slots. A chunk is returned to the system once
+ * none of its slots is used, unless the pool would be left with less than a chunk's worth of free
+ * slots, so that closing a large document gives its memory back.
+ */
+class BlockDataPool
+{
+public:
+    void* allocate()
+    {
+        if (m_available.empty())
+            grow();
+
+        // Filling the chunks with the lowest addresses first lets the others run empty.
+        Chunk& chunk = *m_chunks.at(*m_available.begin());
+        Slot* slot = chunk.free;
+        chunk.free = slot->next;
+        if (++chunk.used == CHUNK_SIZE)
+            m_available.erase(m_available.begin());
+        --m_freeCount;
+        return slot;
+    }
+
+    void deallocate(void* ptr)
+    {
+        auto slot = static_cast<Slot*>(ptr);
+        auto it = --m_chunks.upper_bound(slot);
+        Chunk& chunk = *it->second;
+
+        slot->next = chunk.free;
+        chunk.free = slot;
+        if (chunk.used-- == CHUNK_SIZE)
+            m_available.insert(it->first);
+        ++m_freeCount;
+
+        if (chunk.used == 0 && m_freeCount - CHUNK_SIZE >= CHUNK_SIZE) {
+            m_available.erase(it->first);
+            m_chunks.erase(it);
+            m_freeCount -= CHUNK_SIZE;
+        }
+    }
+
+    void reserve(int count)
+    {
+        while (count > m_freeCount)
+            grow();
+    }
+
+private:
+    union Slot {
+        Slot* next;
+        std::aligned_storage<sizeof(TextBlockUserData), alignof(TextBlockUserData)>::type storage;
+    };
+
+    struct Chunk {
+        std::unique_ptr<Slot[]> slots {new Slot[CHUNK_SIZE]};
+        Slot* free = nullptr;   // The chunk's unused slots
+        int used = 0;
+    };
+
+    void grow()
+    {
+        std::unique_ptr<Chunk> chunk(new Chunk);
+        for (int i = CHUNK_SIZE - 1; i >= 0; --i) {
+            chunk->slots[i].next = chunk->free;
+            chunk->free = &chunk->slots[i];
+        }
+
+        const Slot* first = chunk->slots.get();
+        m_chunks.emplace(first, std::move(chunk));
+        m_available.insert(first);
+        m_freeCount += CHUNK_SIZE;
+    }
+
+    std::map<const Slot*, std::unique_ptr<Chunk>> m_chunks; // Keyed by their first slot
+    std::set<const Slot*> m_available;                      // Chunks with unused slots
+    int m_freeCount = 0;
+};
+
+// The pool is never destroyed: documents may still delete their blocks' data during static
+// destruction.
+BlockDataPool& pool()
+{
+    static auto instance = new BlockDataPool;
+    return *instance;
+}
+
+} // namespace
+
+void FoldingRegionList::push_back(const FoldingRegion& region)
+{
+    if (m_size < INLINE_SIZE) {
+        m_inline[m_size] = region;
+    } else {
+        if (m_size == INLINE_SIZE) {
+            m_overflow.reserve(INLINE_SIZE * 2);
+            for (const auto& r : m_inline)
+                m_overflow.push_back(r);
+        }
+        m_overflow.push_back(region);
+    }
+    ++m_size;
+}
+
+void FoldingRegionList::remove(int i)
+{
+    Q_ASSERT(i >= 0 && i < m_size);
+
+    if (m_size <= INLINE_SIZE) {
+        for (int j = i + 1; j < m_size; ++j)
+            m_inline[j - 1] = m_inline[j];
+        --m_size;
+        return;
+    }
+
+    m_overflow.remove(i);
+    if (--m_size == INLINE_SIZE) {
+        for (int j = 0; j < INLINE_SIZE; ++j)
+            m_inline[j] = m_overflow.at(j);
+        m_overflow = QVector<FoldingRegion>();
+    }
+}
+
+TextBlockUserData::TextBlockUserData() = default;
+
+TextBlockUserData::~TextBlockUserData() = default;
+
+void* TextBlockUserData::operator new(size_t size)
+{
+    if (size != sizeof(TextBlockUserData))
+        return ::operator new(size);
+    return pool().allocate();
+}
+
+void TextBlockUserData::operator delete(void* ptr, size_t size)
+{
+    if (!ptr)
+        return;
+    if (size != sizeof(TextBlockUserData))
+        ::operator delete(ptr);
+    else
+        pool().deallocate(ptr);
+}
+
+void TextBlockUserData::reserve(int count)
+{
+    pool().reserve(count);
+}
+
+PluginBlockData* TextBlockUserData::pluginData(int id) const
+{
+    if (id < 0 || id >= static_cast<int>(m_pluginData.size()))
+        return nullptr;
+    return m_pluginData[id].get();
+}
+
+void TextBlockUserData::setPluginData(int id, std::unique_ptr<PluginBlockData> data)
+{
+    Q_ASSERT(id >= 0);
+    if (id >= static_cast<int>(m_pluginData.size())) {
+        if (!data)
+            return;
+        m_pluginData.resize(id + 1);
+    }
+    m_pluginData[id] = std::move(data);
+}
+
+} // namespace ote
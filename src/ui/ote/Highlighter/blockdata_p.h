@@ -0,0 +1,120 @@
+#ifndef BLOCKDATA_P_H
+#define BLOCKDATA_P_H
+
+#include "fmtrangelist.h"
+#include "foldingregion.h"
+#include "state.h"
+#include "syntaxhighlighter.h"
+
+#include <QTextBlock>
+#include <QTextBlockUserData>
+#include <QVector>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace ote {
+
+struct HighlightedBlock;
+
+/**
+ * FormatRun
+ * A run of characters of a text block that have the same format, identified by Format::id().
+ * Runs don't depend on the theme, so switching themes only converts them to QTextCharFormats
+ * again without rerunning the rule engine.
+ */
+struct FormatRun {
+    int offset;
+    int length;
+    quint16 formatId;
+};
+
+/**
+ * FoldingRegionList
+ * The folding regions of a single text block. Most blocks have none or only a few,
+ * so up to INLINE_SIZE regions are stored in place without a heap allocation.
+ */
+class FoldingRegionList
+{
+public:
+    int size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+
+    const FoldingRegion& at(int i) const { return data()[i]; }
+    const FoldingRegion* constBegin() const { return data(); }
+    const FoldingRegion* constEnd() const { return data() + m_size; }
+
+    void push_back(const FoldingRegion& region);
+    void remove(int i);
+
+    bool operator==(const FoldingRegionList& other) const
+    {
+        return m_size == other.m_size && std::equal(constBegin(), constEnd(), other.constBegin());
+    }
+
+private:
+    static const int INLINE_SIZE = 3;
+
+    const FoldingRegion* data() const { return m_size > INLINE_SIZE ? m_overflow.constData() : m_inline; }
+
+    FoldingRegion m_inline[INLINE_SIZE];
+    QVector<FoldingRegion> m_overflow; // Holds all regions once there are more than INLINE_SIZE
+    int m_size = 0;
+};
+
+/**
+ * TextBlockUserData
+ * The highlighting data of a text block. Instances are allocated from a pool shared by all
+ * documents instead of one by one, and are the only user data SyntaxHighlighter sets on its
+ * document's blocks, so they can be accessed without a dynamic_cast.
+ * They must only be created and destroyed on the GUI thread.
+ */
+class TextBlockUserData : public QTextBlockUserData
+{
+public:
+    TextBlockUserData();
+    ~TextBlockUserData() override;
+
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+
+    /**
+     * Makes sure that the data of @p count more blocks can be created without allocating,
+     * e.g. before highlighting a newly loaded document.
+     */
+    static void reserve(int count);
+
+    /** Returns the data of @p block, or nullptr if it has none yet. */
+    static TextBlockUserData* get(const QTextBlock& block)
+    {
+        return static_cast<TextBlockUserData*>(block.userData());
+    }
+
+    PluginBlockData* pluginData(int id) const;
+    void setPluginData(int id, std::unique_ptr<PluginBlockData> data);
+
+    State state;
+    QVector<FormatRun> formats;
+    FoldingRegionList foldingRegions;
+    FmtRangeList fmtList;
+    bool bookmarked = false;
+    bool hasState = false;      // Whether 'state' is valid. It may have been computed without applying formats.
+    bool highlighted = false;   // Whether the block's formats are up to date
+
+    // Set by SyntaxHighlighter::applyResults() right before the block is rehighlighted
+    std::unique_ptr<HighlightedBlock> pendingResult;
+
+    // Where to resume a line that was too long to be highlighted completely: its partialOffset,
+    // resumeState and folding regions so far. Its formats are the ones above, so they aren't copied.
+    std::unique_ptr<HighlightedBlock> partial;
+
+private:
+    std::vector<std::unique_ptr<PluginBlockData>> m_pluginData; // Indexed by plugin type id
+};
+
+} // namespace ote
+
+Q_DECLARE_TYPEINFO(ote::FormatRun, Q_PRIMITIVE_TYPE);
+
+#endif // BLOCKDATA_P_H
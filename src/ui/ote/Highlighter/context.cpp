@@ -28,10 +28,14 @@
 #include "rule_p.h"
 #include "xml_p.h"
 
+#include <QDataStream>
 #include <QDebug>
 #include <QString>
 #include <QXmlStreamReader>
 
+#include <bitset>
+#include <map>
+
 using namespace ote;
 
 Definition Context::definition() const
@@ -92,6 +96,42 @@ void Context::load(QXmlStreamReader& reader)
     }
 }
 
+bool Context::load(QDataStream& stream)
+{
+    stream >> m_name >> m_attribute;
+    m_lineEndContext.load(stream);
+    m_lineEmptyContext.load(stream);
+    m_fallthroughContext.load(stream);
+    stream >> m_fallthrough >> m_noIndentationBasedFolding;
+
+    quint32 ruleCount = 0;
+    stream >> ruleCount;
+    for (quint32 i = 0; i < ruleCount && stream.status() == QDataStream::Ok; ++i) {
+        auto rule = Rule::create(stream);
+        if (!rule)
+            return false;
+        rule->setDefinition(m_def.definition());
+        if (!rule->load(stream))
+            return false;
+        m_rules.push_back(rule);
+    }
+
+    return stream.status() == QDataStream::Ok;
+}
+
+void Context::save(QDataStream& stream) const
+{
+    stream << m_name << m_attribute;
+    m_lineEndContext.save(stream);
+    m_lineEmptyContext.save(stream);
+    m_fallthroughContext.save(stream);
+    stream << m_fallthrough << m_noIndentationBasedFolding;
+
+    stream << quint32(m_rules.size());
+    for (const auto& rule : m_rules)
+        rule->save(stream);
+}
+
 void Context::resolveContexts()
 {
     const auto def = m_def.definition();
@@ -181,6 +221,37 @@ void Context::resolveIncludes()
     m_resolveState = Resolved;
 }
 
+void Context::buildDispatchTable()
+{
+    const int ruleCount = static_cast<int>(m_rules.size());
+
+    std::vector<std::bitset<128>> firstChars(ruleCount);
+    std::vector<bool> matchesAny(ruleCount);
+    for (int i = 0; i < ruleCount; ++i)
+        matchesAny[i] = !m_rules[i]->firstCharacters(firstChars[i]);
+
+    m_dispatchSlots.clear();
+    std::map<std::vector<int>, std::pair<int, int>> buckets;
+
+    for (int c = 0; c <= 128; ++c) {
+        std::vector<int> candidates;
+        for (int i = 0; i < ruleCount; ++i) {
+            if (c == 128 || matchesAny[i] || firstChars[i].test(c))
+                candidates.push_back(i);
+        }
+
+        auto it = buckets.find(candidates);
+        if (it == buckets.end()) {
+            const int first = static_cast<int>(m_dispatchSlots.size());
+            m_dispatchSlots.insert(m_dispatchSlots.end(), candidates.begin(), candidates.end());
+            it = buckets.emplace(std::move(candidates), std::make_pair(first, static_cast<int>(m_dispatchSlots.size()))).first;
+        }
+        m_dispatchRanges[c] = it->second;
+    }
+
+    m_dispatchSlots.shrink_to_fit();
+}
+
 void Context::resolveAttributeFormat()
 {
     /**
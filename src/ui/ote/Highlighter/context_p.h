@@ -32,8 +32,11 @@
 
 #include <QString>
 
+#include <array>
+#include <utility>
 #include <vector>
 
+class QDataStream;
 class QXmlStreamReader;
 
 namespace ote {
@@ -82,6 +85,23 @@ public:
         return m_rules;
     }
 
+    /**
+     * Indices into rules() of the rules that may match at a position starting with @p c,
+     * in declaration order.
+     */
+    struct RuleSlots {
+        const int *first;
+        const int *last;
+        const int *begin() const { return first; }
+        const int *end() const { return last; }
+    };
+
+    RuleSlots candidateRules(QChar c) const
+    {
+        const auto& range = m_dispatchRanges[c.unicode() < 128 ? c.unicode() : 128];
+        return {m_dispatchSlots.data() + range.first, m_dispatchSlots.data() + range.second};
+    }
+
     /**
      * Returns @c true, when indentationBasedFolding is enabled for the
      * associated Definition and when "noIndentationBasedFolding" is NOT set.
@@ -89,9 +109,15 @@ public:
     bool indentationBasedFoldingEnabled() const;
 
     void load(QXmlStreamReader &reader);
+
+    /** Reads/writes the context as loaded from XML, before any resolving, from/to a definition cache. */
+    bool load(QDataStream &stream);
+    void save(QDataStream &stream) const;
+
     void resolveContexts();
     void resolveIncludes();
     void resolveAttributeFormat();
+    void buildDispatchTable();
 
 private:
     Q_DISABLE_COPY(Context)
@@ -128,6 +154,14 @@ private:
 
     std::vector<Rule::Ptr> m_rules;
 
+    /**
+     * dispatch table: the range of m_dispatchSlots holding the candidate rules for each ASCII
+     * character, plus one bucket with all rules for everything else. See candidateRules().
+     * Characters with the same candidates share their slots.
+     */
+    std::vector<int> m_dispatchSlots;
+    std::array<std::pair<int, int>, 129> m_dispatchRanges = {};
+
     ResolveState m_resolveState = Unknown;
     bool m_fallthrough = false;
     bool m_noIndentationBasedFolding = false;
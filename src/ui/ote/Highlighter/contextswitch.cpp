@@ -26,6 +26,7 @@
 #include "definition_p.h"
 #include "repository.h"
 
+#include <QDataStream>
 #include <QDebug>
 
 using namespace ote;
@@ -71,6 +72,18 @@ void ContextSwitch::parse(const QStringRef& contextInstr)
     }
 }
 
+void ContextSwitch::load(QDataStream& stream)
+{
+    qint32 popCount = 0;
+    stream >> m_defName >> m_contextName >> popCount;
+    m_popCount = popCount;
+}
+
+void ContextSwitch::save(QDataStream& stream) const
+{
+    stream << m_defName << m_contextName << qint32(m_popCount);
+}
+
 void ContextSwitch::resolve(const Definition& def)
 {
     auto d = def;
@@ -26,6 +26,8 @@
 
 #include <QString>
 
+class QDataStream;
+
 namespace ote {
 
 class Context;
@@ -45,6 +47,10 @@ public:
     void parse(const QStringRef &contextInstr);
     void resolve(const Definition &def);
 
+    /** Reads/writes the parsed, unresolved switch from/to a definition cache. */
+    void load(QDataStream &stream);
+    void save(QDataStream &stream) const;
+
 private:
     QString m_defName;
     QString m_contextName;
@@ -35,10 +35,16 @@
 #include "xml_p.h"
 
 #include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDebug>
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QHash>
 #include <QJsonObject>
+#include <QMutexLocker>
+#include <QSaveFile>
 #include <QStringList>
 #include <QVector>
 #include <QXmlStreamReader>
@@ -357,39 +363,215 @@ bool DefinitionData::load()
     if (fileName.isEmpty())
         return false;
 
+    if (loaded.load(std::memory_order_acquire))
+        return true;
+
+    // Only one thread loads definitions at a time. Another thread may have loaded this one while
+    // we were waiting, or it's being loaded further up this thread's stack by an include.
+    QMutexLocker lock(repo ? &RepositoryPrivate::get(repo)->m_loadMutex : nullptr);
     if (isLoaded())
         return true;
 
-    QFile file(fileName);
-    if (!file.open(QFile::ReadOnly))
-        return false;
+    const bool cached = loadFromCache();
+    if (!cached) {
+        QFile file(fileName);
+        if (!file.open(QFile::ReadOnly))
+            return false;
 
-    QXmlStreamReader reader(&file);
-    while (!reader.atEnd()) {
-        const auto token = reader.readNext();
-        if (token != QXmlStreamReader::StartElement)
-            continue;
+        QXmlStreamReader reader(&file);
+        while (!reader.atEnd()) {
+            const auto token = reader.readNext();
+            if (token != QXmlStreamReader::StartElement)
+                continue;
 
-        if (reader.name() == QLatin1String("highlighting"))
-            loadHighlighting(reader);
+            if (reader.name() == QLatin1String("highlighting"))
+                loadHighlighting(reader);
 
-        else if (reader.name() == QLatin1String("general"))
-            loadGeneral(reader);
+            else if (reader.name() == QLatin1String("general"))
+                loadGeneral(reader);
+        }
     }
 
     for (auto it = keywordLists.begin(); it != keywordLists.end(); ++it)
         (*it).setCaseSensitivity(caseSensitive);
 
+    if (!cached)
+        saveToCache();
+
     foreach (auto context, contexts) {
         context->resolveContexts();
         context->resolveIncludes();
         context->resolveAttributeFormat();
+        context->buildDispatchTable();
     }
 
     Q_ASSERT(std::is_sorted(wordDelimiters.constBegin(), wordDelimiters.constEnd()));
+    loaded.store(true, std::memory_order_release);
     return true;
 }
 
+namespace {
+const QByteArray CACHE_MAGIC = QByteArrayLiteral("NQQSYNTX");
+// Bump whenever the layout written by saveToCache() or any of the save() methods changes.
+const quint32 CACHE_VERSION = 2;
+}
+
+QString DefinitionData::cacheFileName() const
+{
+    if (!repo || fileName.isEmpty())
+        return QString();
+
+    const QString cachePath = RepositoryPrivate::get(repo)->m_cachePath;
+    if (cachePath.isEmpty())
+        return QString();
+
+    const auto hash = QCryptographicHash::hash(fileName.toUtf8(), QCryptographicHash::Sha1);
+    return cachePath + QLatin1Char('/') + QString::fromLatin1(hash.toHex()) + QStringLiteral(".bin");
+}
+
+bool DefinitionData::loadFromCache()
+{
+    const auto cacheFile = cacheFileName();
+    if (cacheFile.isEmpty())
+        return false;
+
+    QFile file(cacheFile);
+    if (!file.open(QFile::ReadOnly))
+        return false;
+
+    // The data is only read once, so map the file rather than copying it.
+    const auto size = file.size();
+    const uchar* data = size > 0 ? file.map(0, size) : nullptr;
+    if (!data)
+        return false;
+
+    const auto bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(data), int(size));
+    QDataStream stream(bytes);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    QByteArray magic;
+    quint32 version = 0;
+    QString source;
+    qint64 modified = 0;
+    qint64 sourceSize = 0;
+    stream >> magic >> version >> source >> modified >> sourceSize;
+
+    const QFileInfo info(fileName);
+    if (stream.status() != QDataStream::Ok || magic != CACHE_MAGIC || version != CACHE_VERSION ||
+        source != fileName || modified != info.lastModified().toMSecsSinceEpoch() || sourceSize != info.size())
+        return false;
+
+    if (!loadCacheData(stream) || stream.status() != QDataStream::Ok || !stream.atEnd()) {
+        qWarning() << "Ignoring corrupt syntax definition cache" << cacheFile;
+        keywordLists.clear();
+        qDeleteAll(contexts);
+        contexts.clear();
+        formats.clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool DefinitionData::loadCacheData(QDataStream& stream)
+{
+    qint32 caseSensitivity = Qt::CaseSensitive;
+    QString delimiters;
+    QString wrapDelimiters;
+    bool indentationFolding = false;
+    QStringList ignoreList;
+    QString commentMarker;
+    qint32 commentPosition = 0;
+    QString commentStartMarker;
+    QString commentEndMarker;
+    QVector<QPair<QChar, QString>> encodings;
+
+    stream >> caseSensitivity >> delimiters >> wrapDelimiters >> indentationFolding >> ignoreList >> commentMarker >>
+        commentPosition >> commentStartMarker >> commentEndMarker >> encodings;
+
+    quint32 count = 0;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        KeywordList keywords;
+        keywords.load(stream);
+        keywordLists.insert(keywords.name(), keywords);
+    }
+
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        Format f;
+        auto formatData = FormatPrivate::detachAndGet(f);
+        formatData->definition = q;
+        formatData->load(stream);
+        formatData->id = RepositoryPrivate::get(repo)->nextFormatId();
+        formats.insert(f.name(), f);
+    }
+
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        auto context = new Context;
+        context->setDefinition(q);
+        contexts.push_back(context);
+        if (!context->load(stream))
+            return false;
+    }
+
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    caseSensitive = static_cast<Qt::CaseSensitivity>(caseSensitivity);
+    wordDelimiters = delimiters;
+    wordWrapDelimiters = wrapDelimiters;
+    indentationBasedFolding = indentationFolding;
+    foldingIgnoreList = ignoreList;
+    singleLineCommentMarker = commentMarker;
+    singleLineCommentPosition = static_cast<CommentPosition>(commentPosition);
+    multiLineCommentStartMarker = commentStartMarker;
+    multiLineCommentEndMarker = commentEndMarker;
+    characterEncodings = encodings;
+    return true;
+}
+
+void DefinitionData::saveToCache() const
+{
+    const auto cacheFile = cacheFileName();
+    if (cacheFile.isEmpty())
+        return;
+
+    QDir().mkpath(QFileInfo(cacheFile).absolutePath());
+
+    // QSaveFile makes sure that a concurrently starting instance never reads a partial cache.
+    QSaveFile file(cacheFile);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    const QFileInfo info(fileName);
+    stream << CACHE_MAGIC << CACHE_VERSION << fileName << qint64(info.lastModified().toMSecsSinceEpoch())
+           << qint64(info.size());
+
+    stream << qint32(caseSensitive) << wordDelimiters << wordWrapDelimiters << indentationBasedFolding
+           << foldingIgnoreList << singleLineCommentMarker << qint32(singleLineCommentPosition)
+           << multiLineCommentStartMarker << multiLineCommentEndMarker << characterEncodings;
+
+    stream << quint32(keywordLists.size());
+    for (const auto& keywords : keywordLists)
+        keywords.save(stream);
+
+    stream << quint32(formats.size());
+    for (const auto& format : formats)
+        FormatPrivate::get(format)->save(stream);
+
+    stream << quint32(contexts.size());
+    for (const auto context : contexts)
+        context->save(stream);
+
+    if (stream.status() == QDataStream::Ok)
+        file.commit();
+}
+
 void DefinitionData::clear()
 {
     // keep only name and repo, so we can re-lookup to make references persist over repo reloads
@@ -397,6 +579,7 @@ void DefinitionData::clear()
     qDeleteAll(contexts);
     contexts.clear();
     formats.clear();
+    loaded = false;
 
     fileName.clear();
     section.clear();
@@ -458,6 +641,24 @@ bool DefinitionData::loadMetaData(const QString& file, const QJsonObject& obj)
     return true;
 }
 
+QJsonObject DefinitionData::saveMetaData() const
+{
+    // the counterpart of loadMetaData(const QString&, const QJsonObject&), used for index.katesyntax
+    QJsonObject obj;
+    obj.insert(QLatin1String("name"), name);
+    obj.insert(QLatin1String("section"), section);
+    obj.insert(QLatin1String("version"), version);
+    obj.insert(QLatin1String("priority"), priority);
+    obj.insert(QLatin1String("style"), style);
+    obj.insert(QLatin1String("author"), author);
+    obj.insert(QLatin1String("license"), license);
+    obj.insert(QLatin1String("indenter"), indenter);
+    obj.insert(QLatin1String("hidden"), hidden);
+    obj.insert(QLatin1String("extensions"), QStringList(extensions.toList()).join(QLatin1Char(';')));
+    obj.insert(QLatin1String("mimetype"), QStringList(mimetypes.toList()).join(QLatin1Char(';')));
+    return obj;
+}
+
 bool DefinitionData::loadLanguage(QXmlStreamReader& reader)
 {
     Q_ASSERT(reader.name() == QLatin1String("language"));
@@ -31,7 +31,10 @@
 #include <QString>
 #include <QVector>
 
+#include <atomic>
+
 QT_BEGIN_NAMESPACE
+class QDataStream;
 class QXmlStreamReader;
 class QJsonObject;
 QT_END_NAMESPACE
@@ -51,6 +54,7 @@ public:
     bool isLoaded() const;
     bool loadMetaData(const QString &definitionFileName);
     bool loadMetaData(const QString &fileName, const QJsonObject &obj);
+    QJsonObject saveMetaData() const;
 
     void clear();
 
@@ -65,6 +69,16 @@ public:
     void loadSpellchecking(QXmlStreamReader &reader);
     bool checkKateVersion(const QStringRef &verStr);
 
+    /**
+     * The parsed, but not yet resolved definition is cached in a binary file so that
+     * the XML file doesn't need to be parsed again. The cache is ignored whenever the
+     * XML file's path, size or modification time doesn't match.
+     */
+    QString cacheFileName() const;
+    bool loadFromCache();
+    bool loadCacheData(QDataStream &stream);
+    void saveToCache() const;
+
     KeywordList *keywordList(const QString &name);
     bool isWordDelimiter(QChar c) const;
 
@@ -105,6 +119,10 @@ public:
     int version = 0;
     int priority = 0;
     bool hidden = false;
+
+    // Set once load() has completed. Definitions may be loaded on a background thread by
+    // Repository::warmUp(), so this is checked before taking RepositoryPrivate::m_loadMutex.
+    std::atomic<bool> loaded{false};
 };
 }
 
@@ -16,6 +16,9 @@ public:
     };
 
     FmtRangeList();
+    FmtRangeList(const FmtRangeList&) = default;
+    FmtRangeList(FmtRangeList&&) = default;
+    FmtRangeList& operator=(const FmtRangeList&) = default;
     FmtRangeList& operator=(FmtRangeList&&) = default;
 
     void clear() { m_vec.clear(); }
@@ -34,11 +37,44 @@ public:
         }
     }
 
+    // Appends the ranges of 'other', which must all begin after the ranges of this list.
+    void append(const FmtRangeList& other) {
+        for (const auto& range : other.m_vec)
+            append(range.begin, range.end, range.type);
+    }
+
     bool isFormat(int from, int to, char type) const {
-        auto it = std::find_if(m_vec.begin(), m_vec.end(), [from, to, type](const FmtRange& r){
-            return r.begin < from && r.end > to && r.type == type;
+        return formatAt(from, to) == type;
+    }
+
+    // Returns the type of the range that strictly encloses [from,to], or 0 if there is none.
+    // Ranges are appended in order and don't overlap, so the only candidate is the last range
+    // beginning before 'from'.
+    char formatAt(int from, int to) const {
+        auto it = std::lower_bound(m_vec.begin(), m_vec.end(), from, [](const FmtRange& r, int pos) {
+            return r.begin < pos;
         });
-        return it != m_vec.end();
+        if (it == m_vec.begin())
+            return 0;
+        --it;
+        return it->end > to ? it->type : 0;
+    }
+
+    // Same as formatAt(pos, pos) for each of the ascending positions in 'positions', in a
+    // single pass over the ranges.
+    std::vector<char> formatsAt(const std::vector<int>& positions) const {
+        std::vector<char> types(positions.size(), 0);
+        auto it = m_vec.begin();
+        for (size_t i = 0; i < positions.size(); ++i) {
+            const int pos = positions[i];
+            while (it != m_vec.end() && it->end <= pos)
+                ++it;
+            if (it == m_vec.end())
+                break;
+            if (it->begin < pos)
+                types[i] = it->type;
+        }
+        return types;
     }
 
     //const std::vector<FmtRange>& ranges() const { return m_vec; }
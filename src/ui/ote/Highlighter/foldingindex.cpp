@@ -0,0 +1,79 @@
+#include "foldingindex_p.h"
+
+#include "blockdata_p.h"
+
+#include <QHash>
+#include <QTextDocument>
+
+#include <algorithm>
+
+namespace ote {
+
+void FoldingIndex::update(const QTextDocument* document)
+{
+    if (m_validUntil == std::numeric_limits<int>::max())
+        return;
+
+    const auto firstOutdated = std::lower_bound(m_events.begin(), m_events.end(), m_validUntil,
+                                                [](const Event& e, int block) { return e.block < block; });
+    m_events.erase(firstOutdated, m_events.end());
+
+    int number = m_validUntil;
+    for (auto block = document->findBlockByNumber(m_validUntil); block.isValid(); block = block.next(), ++number) {
+        const auto data = TextBlockUserData::get(block);
+        if (!data || data->foldingRegions.isEmpty())
+            continue;
+
+        for (auto it = data->foldingRegions.constBegin(); it != data->foldingRegions.constEnd(); ++it)
+            m_events.push_back({number, (*it).id(), (*it).type() == FoldingRegion::Begin, -1});
+    }
+
+    // Matching is cheap compared to collecting the events, so it's always redone completely:
+    // the regions of a changed block may close regions beginning anywhere before it.
+    m_beginBlocks.clear();
+    QHash<quint16, std::vector<size_t>> open;
+    for (size_t i = 0; i < m_events.size(); ++i) {
+        auto& event = m_events[i];
+        if (event.begin) {
+            event.end = -1;
+            open[event.id].push_back(i);
+            if (m_beginBlocks.empty() || m_beginBlocks.back() != event.block)
+                m_beginBlocks.push_back(event.block);
+            continue;
+        }
+
+        auto& stack = open[event.id];
+        if (!stack.empty()) {
+            m_events[stack.back()].end = event.block;
+            stack.pop_back();
+        }
+    }
+
+    m_validUntil = std::numeric_limits<int>::max();
+}
+
+int FoldingIndex::regionEnd(const QTextDocument* document, int block)
+{
+    update(document);
+
+    auto it = std::upper_bound(m_events.begin(), m_events.end(), block,
+                               [](int block, const Event& e) { return block < e.block; });
+    while (it != m_events.begin()) {
+        --it;
+        if (it->block != block)
+            break;
+        if (it->begin)
+            return it->end;
+    }
+    return -1;
+}
+
+int FoldingIndex::regionBegin(const QTextDocument* document, int block)
+{
+    update(document);
+
+    const auto it = std::upper_bound(m_beginBlocks.begin(), m_beginBlocks.end(), block);
+    return it == m_beginBlocks.begin() ? -1 : *(it - 1);
+}
+
+} // namespace ote
@@ -0,0 +1,60 @@
+#ifndef FOLDINGINDEX_P_H
+#define FOLDINGINDEX_P_H
+
+#include <QtGlobal>
+
+#include <limits>
+#include <vector>
+
+class QTextDocument;
+
+namespace ote {
+
+/**
+ * FoldingIndex
+ * An index of the folding regions of a document, sorted by block number, with each region's
+ * begin matched to its end. Finding the end or the begin of a region is a binary search.
+ *
+ * The index is updated lazily: SyntaxHighlighter invalidates it from the first block whose
+ * regions changed, or from where blocks were inserted or removed, and the next query only
+ * collects the regions from that block on. Regions of the blocks before it are kept.
+ */
+class FoldingIndex
+{
+public:
+    /** Marks the regions of block number @p block and all following blocks as outdated. */
+    void invalidateFrom(int block)
+    {
+        m_validUntil = qMin(m_validUntil, block);
+    }
+
+    /**
+     * Returns the number of the block ending the region that begins last in block
+     * number @p block, or -1 if there is no such region or it isn't terminated.
+     */
+    int regionEnd(const QTextDocument* document, int block);
+
+    /**
+     * Returns the number of the last block up to and including block number @p block
+     * that begins a region, or -1 if there is none.
+     */
+    int regionBegin(const QTextDocument* document, int block);
+
+private:
+    void update(const QTextDocument* document);
+
+    struct Event {
+        int block;
+        quint16 id;
+        bool begin;
+        int end;    // For begins, the number of the block ending the region, or -1
+    };
+
+    std::vector<Event> m_events;    // In document order
+    std::vector<int> m_beginBlocks; // Numbers of the blocks containing a begin, sorted
+    int m_validUntil = 0;           // Events of the blocks before this one are up to date
+};
+
+} // namespace ote
+
+#endif // FOLDINGINDEX_P_H
@@ -31,6 +31,7 @@
 #include "xml_p.h"
 
 #include <QColor>
+#include <QDataStream>
 #include <QDebug>
 #include <QMetaEnum>
 #include <QXmlStreamReader>
@@ -59,6 +60,11 @@ FormatPrivate* FormatPrivate::detachAndGet(Format& format)
     return format.d.data();
 }
 
+const FormatPrivate* FormatPrivate::get(const Format& format)
+{
+    return format.d.data();
+}
+
 TextStyleData FormatPrivate::styleOverride(const Theme& theme) const
 {
     const auto themeData = ThemeData::get(theme);
@@ -287,3 +293,35 @@ void FormatPrivate::load(QXmlStreamReader& reader)
         spellCheck = Xml::attrToBool(ref);
     }
 }
+
+void FormatPrivate::load(QDataStream& stream)
+{
+    qint32 styleNum = Theme::Normal;
+    quint8 flags = 0;
+    qint8 type = 0;
+
+    stream >> name >> styleNum >> style.textColor >> style.backgroundColor >> style.selectedTextColor
+           >> style.selectedBackgroundColor >> flags >> spellCheck >> type;
+
+    defaultStyle = static_cast<Theme::TextStyle>(styleNum);
+    fmtType = type;
+    style.bold = flags & 0x01;
+    style.italic = flags & 0x02;
+    style.underline = flags & 0x04;
+    style.strikeThrough = flags & 0x08;
+    style.hasBold = flags & 0x10;
+    style.hasItalic = flags & 0x20;
+    style.hasUnderline = flags & 0x40;
+    style.hasStrikeThrough = flags & 0x80;
+}
+
+void FormatPrivate::save(QDataStream& stream) const
+{
+    const quint8 flags = (style.bold ? 0x01 : 0) | (style.italic ? 0x02 : 0) | (style.underline ? 0x04 : 0) |
+                         (style.strikeThrough ? 0x08 : 0) | (style.hasBold ? 0x10 : 0) |
+                         (style.hasItalic ? 0x20 : 0) | (style.hasUnderline ? 0x40 : 0) |
+                         (style.hasStrikeThrough ? 0x80 : 0);
+
+    stream << name << qint32(defaultStyle) << style.textColor << style.backgroundColor << style.selectedTextColor
+           << style.selectedBackgroundColor << flags << spellCheck << qint8(fmtType);
+}
@@ -31,6 +31,8 @@
 #include <QSharedData>
 #include <QString>
 
+class QDataStream;
+
 namespace ote {
 
 class FormatPrivate : public QSharedData
@@ -38,9 +40,12 @@ class FormatPrivate : public QSharedData
 public:
     FormatPrivate() = default;
     static FormatPrivate* detachAndGet(Format &format);
+    static const FormatPrivate* get(const Format &format);
 
     TextStyleData styleOverride(const Theme &theme) const;
     void load(QXmlStreamReader &reader);
+    void load(QDataStream &stream);
+    void save(QDataStream &stream) const;
 
     DefinitionRef definition;
     QString name;
@@ -0,0 +1,223 @@
+#include "highlightprofiler_p.h"
+
+#include "context_p.h"
+#include "definition.h"
+#include "rule_p.h"
+
+#include <QDebug>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextStream>
+
+#include <algorithm>
+#include <atomic>
+
+namespace ote {
+
+namespace {
+
+struct ContextEntry {
+    HighlightProfiler::ContextStatistics stats;
+    QHash<int, HighlightProfiler::RuleStatistics> rules;
+};
+
+struct DefinitionEntry {
+    HighlightProfiler::DefinitionStatistics stats;
+    QHash<QString, ContextEntry> contexts;
+};
+
+struct HighlightProfilerData {
+    ~HighlightProfilerData();
+
+    QVector<HighlightProfiler::DefinitionStatistics> statistics();
+    DefinitionEntry &definition(const QString &name);
+
+    // Keyed by name rather than by pointer: definitions may be reloaded while profiling.
+    QMutex mutex;
+    QHash<QString, DefinitionEntry> definitions;
+
+    std::atomic<bool> enabled {qEnvironmentVariableIsSet("NQQ_PROFILE_HIGHLIGHTING")};
+};
+
+Q_GLOBAL_STATIC(HighlightProfilerData, s_data)
+
+template<typename T>
+void sortByTime(QVector<T> &v)
+{
+    std::sort(v.begin(), v.end(), [](const T &a, const T &b) {
+        return a.totalNsecs > b.totalNsecs;
+    });
+}
+
+QString formatNsecs(qint64 nsecs)
+{
+    return QStringLiteral("%1 ms").arg(nsecs / 1e6, 0, 'f', 2);
+}
+
+// Names and rule descriptions come last in each multi-arg call: a '%' in a pattern must not be replaced.
+QString formatReport(const QVector<HighlightProfiler::DefinitionStatistics> &all, int maxRules)
+{
+    QString result;
+    QTextStream out(&result);
+
+    out << "Highlighting profile, slowest definitions, contexts and rules first:\n";
+    for (const auto &def : all) {
+        out << QStringLiteral("%1 in rules, %2 in %3 lines, %4 context switches (at most %5 per line): %6\n")
+               .arg(formatNsecs(def.totalNsecs), formatNsecs(def.lineNsecs), QString::number(def.lines),
+                    QString::number(def.contextSwitches), QString::number(def.maxContextSwitches), def.name);
+
+        for (const auto &context : def.contexts) {
+            out << QStringLiteral("  %1, %2 attempts, %3 matches: context %4\n")
+                   .arg(formatNsecs(context.totalNsecs), QString::number(context.attempts),
+                        QString::number(context.matches), context.name);
+
+            const int count = maxRules < 0 ? context.rules.size() : std::min(maxRules, context.rules.size());
+            for (int i = 0; i < count; ++i) {
+                const auto &rule = context.rules.at(i);
+                out << QStringLiteral("    %1, %2 attempts, %3 matches: #%4 %5\n")
+                       .arg(formatNsecs(rule.totalNsecs), QString::number(rule.attempts),
+                            QString::number(rule.matches), QString::number(rule.index), rule.description);
+            }
+            if (count < context.rules.size())
+                out << QStringLiteral("    ... %1 more rules\n").arg(context.rules.size() - count);
+        }
+    }
+
+    out.flush();
+    return result;
+}
+
+} // namespace
+
+HighlightProfilerData::~HighlightProfilerData()
+{
+    if (!enabled)
+        return;
+
+    qInfo().noquote() << formatReport(statistics(), 10);
+}
+
+DefinitionEntry &HighlightProfilerData::definition(const QString &name)
+{
+    auto it = definitions.find(name);
+    if (it == definitions.end()) {
+        it = definitions.insert(name, DefinitionEntry());
+        it->stats.name = name;
+    }
+    return *it;
+}
+
+QVector<HighlightProfiler::DefinitionStatistics> HighlightProfilerData::statistics()
+{
+    QVector<HighlightProfiler::DefinitionStatistics> all;
+
+    {
+        QMutexLocker lock(&mutex);
+        all.reserve(definitions.size());
+        for (const auto &def : definitions) {
+            all.push_back(def.stats);
+            auto &contexts = all.back().contexts;
+            contexts.reserve(def.contexts.size());
+            for (const auto &context : def.contexts) {
+                contexts.push_back(context.stats);
+                auto &rules = contexts.back().rules;
+                rules.reserve(context.rules.size());
+                for (const auto &rule : context.rules)
+                    rules.push_back(rule);
+            }
+        }
+    }
+
+    for (auto &def : all) {
+        for (auto &context : def.contexts)
+            sortByTime(context.rules);
+        sortByTime(def.contexts);
+    }
+    sortByTime(all);
+
+    return all;
+}
+
+void LineProfile::clear()
+{
+    std::fill(rules.begin(), rules.end(), RuleCounters());
+    contextSwitches = 0;
+}
+
+void LineProfile::commit(const Definition &definition, const std::vector<std::pair<const Context *, int>> &contexts,
+                         qint64 lineNsecs)
+{
+    HighlightProfilerData *d = s_data();
+    QMutexLocker lock(&d->mutex);
+
+    auto &lineDef = d->definition(definition.name()).stats;
+    ++lineDef.lines;
+    lineDef.contextSwitches += contextSwitches;
+    lineDef.maxContextSwitches = std::max(lineDef.maxContextSwitches, contextSwitches);
+    lineDef.lineNsecs += lineNsecs;
+
+    for (const auto &block : contexts) {
+        const Context *context = block.first;
+        const auto &contextRules = context->rules();
+        const int count = std::min<int>(contextRules.size(), static_cast<int>(rules.size()) - block.second);
+
+        DefinitionEntry *def = nullptr;
+        ContextEntry *entry = nullptr;
+        for (int slot = 0; slot < count; ++slot) {
+            const auto &counters = rules[block.second + slot];
+            if (counters.attempts == 0)
+                continue;
+
+            if (!entry) {
+                def = &d->definition(context->definition().name());
+                entry = &def->contexts[context->name()];
+                entry->stats.name = context->name();
+            }
+
+            auto it = entry->rules.find(slot);
+            if (it == entry->rules.end()) {
+                it = entry->rules.insert(slot, HighlightProfiler::RuleStatistics());
+                it->description = contextRules[slot]->description();
+                it->index = slot;
+            }
+            it->attempts += counters.attempts;
+            it->matches += counters.matches;
+            it->totalNsecs += counters.nsecs;
+
+            entry->stats.attempts += counters.attempts;
+            entry->stats.matches += counters.matches;
+            entry->stats.totalNsecs += counters.nsecs;
+            def->stats.totalNsecs += counters.nsecs;
+        }
+    }
+}
+
+bool HighlightProfiler::isEnabled()
+{
+    return s_data()->enabled;
+}
+
+void HighlightProfiler::setEnabled(bool enabled)
+{
+    s_data()->enabled = enabled;
+}
+
+QVector<HighlightProfiler::DefinitionStatistics> HighlightProfiler::statistics()
+{
+    return s_data()->statistics();
+}
+
+QString HighlightProfiler::report(int maxRules)
+{
+    return formatReport(statistics(), maxRules);
+}
+
+void HighlightProfiler::resetStatistics()
+{
+    HighlightProfilerData *d = s_data();
+    QMutexLocker lock(&d->mutex);
+    d->definitions.clear();
+}
+
+} // namespace ote
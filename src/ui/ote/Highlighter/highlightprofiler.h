@@ -0,0 +1,72 @@
+#ifndef HIGHLIGHTPROFILER_H
+#define HIGHLIGHTPROFILER_H
+
+#include <QString>
+#include <QVector>
+
+namespace ote {
+
+/**
+ * HighlightProfiler
+ * Opt-in profile of the rule engine of AbstractHighlighter, to find the definitions, contexts and
+ * rules that make a file highlight slowly.
+ *
+ * When profiling is enabled (setEnabled() or the NQQ_PROFILE_HIGHLIGHTING environment variable),
+ * every highlighted line records the rules tried, how many of them matched and the time spent in
+ * them, as well as the number of context switches. The statistics are grouped by definition and
+ * sorted by time spent, slowest first. When enabled, report() is printed on exit.
+ *
+ * Profiling adds a timer call around every rule attempt, so highlighting itself gets slower.
+ * Only the relative numbers are meaningful. All functions are thread-safe.
+ */
+class HighlightProfiler
+{
+public:
+    struct RuleStatistics {
+        QString description;    // See Rule::description()
+        int index = 0;          // Position of the rule in its context, including rules of IncludeRules
+        quint64 attempts = 0;
+        quint64 matches = 0;
+        qint64 totalNsecs = 0;
+    };
+
+    struct ContextStatistics {
+        QString name;
+        quint64 attempts = 0;   // Sum of the attempts of the context's rules
+        quint64 matches = 0;
+        qint64 totalNsecs = 0;
+        QVector<RuleStatistics> rules; // Sorted by total time, slowest first
+    };
+
+    struct DefinitionStatistics {
+        QString name;
+        quint64 lines = 0;          // Lines highlighted with this definition
+        quint64 contextSwitches = 0;
+        int maxContextSwitches = 0; // Most context switches in a single line
+        qint64 lineNsecs = 0;       // Total time spent highlighting the lines
+        qint64 totalNsecs = 0;      // Time spent in the rules of this definition's contexts
+        QVector<ContextStatistics> contexts; // Sorted by total time, slowest first
+    };
+
+    static bool isEnabled();
+    static void setEnabled(bool enabled);
+
+    /**
+     * Returns the recorded statistics of all definitions, sorted by total time spent, slowest first.
+     * Contexts are reported with the definition they belong to, which for embedded languages is
+     * not the definition of the highlighted lines.
+     */
+    static QVector<DefinitionStatistics> statistics();
+
+    /**
+     * Returns statistics() formatted as text, one line per definition, context and rule.
+     * @param maxRules Number of rules listed per context, -1 lists all of them.
+     */
+    static QString report(int maxRules = 10);
+
+    static void resetStatistics();
+};
+
+} // namespace ote
+
+#endif // HIGHLIGHTPROFILER_H
@@ -0,0 +1,54 @@
+#ifndef HIGHLIGHTPROFILER_P_H
+#define HIGHLIGHTPROFILER_P_H
+
+#include "highlightprofiler.h"
+
+#include <QtGlobal>
+
+#include <utility>
+#include <vector>
+
+namespace ote {
+
+class Context;
+class Definition;
+
+/**
+ * Counters of a single rule within a single line, see AbstractHighlighter::highlightLine().
+ */
+struct RuleCounters {
+    quint32 attempts = 0;
+    quint32 matches = 0;
+    qint64 nsecs = 0;
+};
+
+/**
+ * The profile of a single line, filled by AbstractHighlighter::highlightLine() without any locking
+ * and merged into the HighlightProfiler statistics once the line is done.
+ * The counters of a context's rules are stored in a block starting at the context's skip offset base,
+ * see AbstractHighlighterPrivate::skipOffsetBase(), so recording an attempt needs no lookup.
+ */
+struct LineProfile {
+    void clear();
+
+    RuleCounters &counters(int index)
+    {
+        if (index >= static_cast<int>(rules.size()))
+            rules.resize(index + 1);
+        return rules[index];
+    }
+
+    /**
+     * Adds this line to the statistics of @p definition.
+     * @param contexts The contexts visited in the line and the index of their rules' block.
+     */
+    void commit(const Definition &definition, const std::vector<std::pair<const Context *, int>> &contexts,
+                qint64 lineNsecs);
+
+    std::vector<RuleCounters> rules;
+    int contextSwitches = 0;
+};
+
+} // namespace ote
+
+#endif // HIGHLIGHTPROFILER_P_H
@@ -0,0 +1,144 @@
+#include "highlightworker_p.h"
+
+#include <QThread>
+
+#include <algorithm>
+
+namespace ote {
+
+namespace {
+
+class WorkerThread : public QThread
+{
+public:
+    WorkerThread()
+    {
+        setObjectName(QStringLiteral("HighlightWorker"));
+        start(QThread::LowPriority);
+    }
+
+    ~WorkerThread() override
+    {
+        quit();
+        wait();
+    }
+};
+
+Q_GLOBAL_STATIC(WorkerThread, s_workerThread)
+
+} // namespace
+
+void HighlightedBlock::addFormat(int offset, int length, const Format& format)
+{
+    if (length == 0)
+        return;
+
+    formats.push_back({offset, length, format});
+
+    if (format.isComment())
+        fmtList.append(offset, offset + length, 'c');
+    else if (format.isString())
+        fmtList.append(offset, offset + length, 's');
+}
+
+void HighlightedBlock::addFolding(const FoldingRegion& region)
+{
+    if (region.type() == FoldingRegion::Begin)
+        foldingRegions.push_back(region);
+
+    if (region.type() == FoldingRegion::End) {
+        for (int i = foldingRegions.size() - 1; i >= 0; --i) {
+            if (foldingRegions.at(i).id() != region.id() || foldingRegions.at(i).type() != FoldingRegion::Begin)
+                continue;
+            foldingRegions.remove(i);
+            return;
+        }
+        foldingRegions.push_back(region);
+    }
+}
+
+HighlightWorker::HighlightWorker(std::shared_ptr<std::atomic<int>> generation)
+    : m_generation(std::move(generation))
+{
+    moveToThread(s_workerThread());
+}
+
+void HighlightWorker::process(QSharedPointer<HighlightJob> job)
+{
+    if (definition() != job->definition)
+        setDefinition(job->definition);
+
+    State state = job->startState;
+    job->results.reserve(job->texts.size());
+
+    const int count = job->texts.size();
+    for (int i = 0; i < count; ++i) {
+        // The text was edited or the highlighter was reconfigured since this job was created.
+        if (job->generation != *m_generation)
+            return;
+
+        job->results.emplace_back();
+        auto& result = job->results.back();
+        const auto& text = job->texts.at(i);
+
+        State lineState = state;
+        int offset = 0;
+        int maxOffset = job->maxLineLength;
+        qint64 maxNsecs = job->maxLineNsecs;
+        if (i == 0 && job->resume) {
+            // Each time a line is resumed, the highlighted part at least doubles. The time limit doesn't
+            // apply, otherwise it would cut every part short. This way a long line's formats are only
+            // applied to the document a logarithmic number of times.
+            result = std::move(*job->resume);
+            offset = result.partialOffset;
+            lineState = result.resumeState;
+            result.resumedFrom = offset;
+            maxOffset = offset + std::max(maxOffset, offset);
+            maxNsecs = -1;
+        }
+        result.partialOffset = -1;
+        result.resumeState = State();
+
+        // Without a result to write to, applyFormat() and applyFolding() skip their work.
+        m_current = job->statesOnly ? nullptr : &result;
+
+        if (text.isEmpty()) {
+            state = highlightLine(text, lineState);
+        } else {
+            int stoppedAt = 0;
+            state = highlightLine(text, lineState, offset, maxOffset, maxNsecs, &stoppedAt);
+            if (stoppedAt < text.size()) {
+                result.partialOffset = stoppedAt;
+                result.resumeState = state;
+                state = lineEndState(state);
+            }
+        }
+        result.state = state;
+
+        if (job->statesOnly)
+            continue;
+
+        job->converged = state == job->oldStates.at(i);
+        if (job->converged && i + 1 < count && job->highlighted.at(i + 1))
+            break;
+    }
+
+    m_current = nullptr;
+    emit finished(job);
+}
+
+void HighlightWorker::applyFormat(int offset, int length, const Format& format)
+{
+    if (m_current)
+        m_current->addFormat(offset, length, format);
+}
+
+void HighlightWorker::applyFolding(int offset, int length, FoldingRegion region)
+{
+    Q_UNUSED(offset);
+    Q_UNUSED(length);
+    if (m_current)
+        m_current->addFolding(region);
+}
+
+} // namespace ote
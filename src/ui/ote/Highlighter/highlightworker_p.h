@@ -0,0 +1,108 @@
+#ifndef HIGHLIGHTWORKER_P_H
+#define HIGHLIGHTWORKER_P_H
+
+#include "abstracthighlighter.h"
+#include "blockdata_p.h"
+#include "definition.h"
+#include "fmtrangelist.h"
+#include "foldingregion.h"
+#include "format.h"
+#include "state.h"
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace ote {
+
+/**
+ * The result of highlighting a single text block: its format runs, folding regions and end state.
+ * Formats are stored independently of the theme; they are converted when applied to the document.
+ */
+struct HighlightedBlock {
+    struct FormatRun {
+        int offset;
+        int length;
+        Format format;
+    };
+
+    void addFormat(int offset, int length, const Format& format);
+    void addFolding(const FoldingRegion& region);
+
+    State state;
+    QVector<FormatRun> formats;
+    FoldingRegionList foldingRegions;
+    FmtRangeList fmtList;
+
+    // Set if the line was too long to be highlighted within the line budget: the offset highlighting
+    // stopped at and the state there, to resume from. The rest of the line is left unformatted and
+    // 'state' is only an approximation.
+    int partialOffset = -1;
+    State resumeState;
+
+    // Set if this result continues a partially highlighted line: formats and fmtList only hold the
+    // part from this offset on, the part before it is already applied to the block.
+    int resumedFrom = -1;
+};
+
+/**
+ * A run of consecutive text blocks to be highlighted by a HighlightWorker. The texts are copied
+ * from the document when the job is created, so the worker never accesses the QTextDocument.
+ */
+struct HighlightJob {
+    int generation = 0;
+    int firstBlock = 0;         // Block number of texts[0]
+    bool statesOnly = false;    // Only compute the end states, e.g. to find the start state of the visible blocks
+    Definition definition;
+    State startState;           // End state of the block before firstBlock
+    QVector<QString> texts;
+    QVector<State> oldStates;   // The blocks' current states, empty if they have none
+    QVector<bool> highlighted;  // Whether the blocks' formats are up to date
+
+    int maxLineLength = -1;     // Line budget, see AbstractHighlighter::highlightLine()
+    qint64 maxLineNsecs = -1;
+    std::unique_ptr<HighlightedBlock> resume; // Where to continue texts[0], see TextBlockUserData::partial
+
+    // Filled by the worker. Shorter than texts if highlighting stopped early: once a block ends in its
+    // old state and the next block is already highlighted, there's nothing left to do.
+    std::vector<HighlightedBlock> results;
+    bool converged = false;     // True if the last result ended in its block's old state
+};
+
+/**
+ * HighlightWorker
+ * Runs the rule engine for a SyntaxHighlighter on a background thread that is shared by all
+ * workers. Jobs whose generation is older than the highlighter's current generation are stale
+ * and abandoned as soon as possible.
+ */
+class HighlightWorker : public QObject, public AbstractHighlighter
+{
+    Q_OBJECT
+public:
+    explicit HighlightWorker(std::shared_ptr<std::atomic<int>> generation);
+
+public slots:
+    void process(QSharedPointer<ote::HighlightJob> job);
+
+signals:
+    void finished(QSharedPointer<ote::HighlightJob> job);
+
+protected:
+    void applyFormat(int offset, int length, const Format& format) override;
+    void applyFolding(int offset, int length, FoldingRegion region) override;
+
+private:
+    std::shared_ptr<std::atomic<int>> m_generation;
+    HighlightedBlock* m_current = nullptr;
+};
+
+} // namespace ote
+
+Q_DECLARE_METATYPE(QSharedPointer<ote::HighlightJob>)
+
+#endif // HIGHLIGHTWORKER_P_H
@@ -23,28 +23,180 @@
 
 #include "keywordlist_p.h"
 
+#include <QDataStream>
 #include <QDebug>
 #include <QXmlStreamReader>
 
 #include <algorithm>
+#include <cstring>
 
 using namespace ote;
 
-bool KeywordList::contains(const QStringRef& str, Qt::CaseSensitivity caseSensitive) const
+namespace {
+
+// Give up on a displacement search after this many attempts, and retry with another seed
+const quint32 MAX_DISPLACEMENT = 1 << 16;
+
+inline quint64 mix(quint64 h)
+{
+    h ^= h >> 33;
+    h *= Q_UINT64_C(0xff51afd7ed558ccd);
+    h ^= h >> 33;
+    h *= Q_UINT64_C(0xc4ceb9fe1a85ec53);
+    h ^= h >> 33;
+    return h;
+}
+
+inline ushort fold(ushort c, Qt::CaseSensitivity caseSensitive)
+{
+    return caseSensitive == Qt::CaseSensitive ? c : QChar::toCaseFolded(c);
+}
+
+// FNV-1a over the (folded) UTF-16 code units
+quint64 hashKeyword(const QChar *str, int length, quint64 seed, Qt::CaseSensitivity caseSensitive)
+{
+    quint64 h = Q_UINT64_C(0xcbf29ce484222325) ^ seed;
+    for (int i = 0; i < length; ++i) {
+        h ^= fold(str[i].unicode(), caseSensitive);
+        h *= Q_UINT64_C(0x100000001b3);
+    }
+    return mix(h);
+}
+
+inline quint32 slotFor(quint64 hash, quint32 displacement, quint32 tableSize)
+{
+    return mix(hash ^ ((quint64(displacement) + 1) * Q_UINT64_C(0x9e3779b97f4a7c15))) % tableSize;
+}
+
+}
+
+void KeywordTable::build(const QStringList& keywords, Qt::CaseSensitivity caseSensitive)
 {
+    m_caseSensitive = caseSensitive;
+    m_built = true;
+    m_displacements.clear();
+    m_slots.clear();
+
     /**
-     * get right vector to search in
+     * collect unique keys, folded the same way as in contains()
      */
-    const auto& vectorToSearch =
-        (caseSensitive == Qt::CaseSensitive) ? m_keywordsSortedCaseSensitive : m_keywordsSortedCaseInsensitive;
+    QVector<QString> keys;
+    QSet<QString> seen;
+    for (const auto& keyword : keywords) {
+        if (keyword.isEmpty())
+            continue;
+
+        QString key = keyword;
+        if (caseSensitive == Qt::CaseInsensitive) {
+            for (auto& c : key)
+                c = QChar(fold(c.unicode(), caseSensitive));
+        }
+
+        if (!seen.contains(key)) {
+            seen.insert(key);
+            keys.push_back(key);
+        }
+    }
+
+    if (keys.isEmpty())
+        return;
+
+    quint32 tableSize = keys.size() + keys.size() / 4 + 1;
+    for (quint64 seed = 0; !tryBuild(keys, seed, tableSize); ++seed)
+        tableSize += tableSize / 8 + 1;
+}
+
+bool KeywordTable::tryBuild(const QVector<QString>& keys, quint64 seed, quint32 tableSize)
+{
+    const quint32 bucketCount = keys.size() / 3 + 1;
+
+    std::vector<quint64> hashes;
+    hashes.reserve(keys.size());
+    std::vector<std::vector<int>> buckets(bucketCount);
+    for (int i = 0; i < keys.size(); ++i) {
+        hashes.push_back(hashKeyword(keys.at(i).constData(), keys.at(i).size(), seed, m_caseSensitive));
+        buckets[hashes.back() % bucketCount].push_back(i);
+    }
 
     /**
-     * search with right predicate
+     * place the largest buckets first, while the table is still mostly empty
      */
-    return std::binary_search(
-        vectorToSearch.begin(), vectorToSearch.end(), str, [caseSensitive](const QStringRef& a, const QStringRef& b) {
-            return a.compare(b, caseSensitive) < 0;
-        });
+    std::vector<quint32> order(bucketCount);
+    for (quint32 b = 0; b < bucketCount; ++b)
+        order[b] = b;
+    std::sort(order.begin(), order.end(), [&buckets](quint32 a, quint32 b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    std::vector<int> occupied(tableSize, -1);
+    std::vector<quint32> displacements(bucketCount, 0);
+    std::vector<quint32> slots;
+
+    for (const auto b : order) {
+        const auto& bucket = buckets[b];
+        if (bucket.empty())
+            break;
+
+        bool placed = false;
+        for (quint32 d = 0; d < MAX_DISPLACEMENT && !placed; ++d) {
+            slots.clear();
+            placed = true;
+            for (const auto key : bucket) {
+                const auto slot = slotFor(hashes[key], d, tableSize);
+                if (occupied[slot] != -1 || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+                    placed = false;
+                    break;
+                }
+                slots.push_back(slot);
+            }
+
+            if (placed) {
+                for (size_t i = 0; i < bucket.size(); ++i)
+                    occupied[slots[i]] = bucket[i];
+                displacements[b] = d;
+            }
+        }
+
+        if (!placed)
+            return false;
+    }
+
+    m_seed = seed;
+    m_displacements = std::move(displacements);
+    m_slots.assign(tableSize, QString());
+    for (quint32 slot = 0; slot < tableSize; ++slot) {
+        if (occupied[slot] != -1)
+            m_slots[slot] = keys.at(occupied[slot]);
+    }
+    return true;
+}
+
+bool KeywordTable::contains(const QStringRef& str) const
+{
+    if (m_slots.empty())
+        return false;
+
+    const auto hash = hashKeyword(str.constData(), str.size(), m_seed, m_caseSensitive);
+    const auto displacement = m_displacements[hash % m_displacements.size()];
+    const auto& key = m_slots[slotFor(hash, displacement, quint32(m_slots.size()))];
+
+    if (key.size() != str.size())
+        return false;
+
+    if (m_caseSensitive == Qt::CaseSensitive)
+        return memcmp(key.constData(), str.constData(), size_t(str.size()) * sizeof(QChar)) == 0;
+
+    for (int i = 0; i < str.size(); ++i) {
+        if (key.at(i).unicode() != fold(str.at(i).unicode(), m_caseSensitive))
+            return false;
+    }
+    return true;
+}
+
+bool KeywordList::contains(const QStringRef& str, Qt::CaseSensitivity caseSensitive) const
+{
+    return (caseSensitive == Qt::CaseSensitive) ? m_caseSensitiveTable.contains(str)
+                                                : m_caseInsensitiveTable.contains(str);
 }
 
 void KeywordList::load(QXmlStreamReader& reader)
@@ -74,6 +226,26 @@ void KeywordList::load(QXmlStreamReader& reader)
     }
 }
 
+void KeywordList::load(QDataStream& stream)
+{
+    qint32 caseSensitive = Qt::CaseSensitive;
+    bool hasCaseSensitiveTable = false;
+    bool hasCaseInsensitiveTable = false;
+    stream >> m_name >> m_keywords >> caseSensitive >> hasCaseSensitiveTable >> hasCaseInsensitiveTable;
+    m_caseSensitive = static_cast<Qt::CaseSensitivity>(caseSensitive);
+
+    if (hasCaseSensitiveTable)
+        initLookupForCaseSensitivity(Qt::CaseSensitive);
+    if (hasCaseInsensitiveTable)
+        initLookupForCaseSensitivity(Qt::CaseInsensitive);
+}
+
+void KeywordList::save(QDataStream& stream) const
+{
+    stream << m_name << m_keywords << qint32(m_caseSensitive) << m_caseSensitiveTable.isBuilt()
+           << m_caseInsensitiveTable.isBuilt();
+}
+
 void KeywordList::setCaseSensitivity(Qt::CaseSensitivity caseSensitive)
 {
     /**
@@ -86,26 +258,12 @@ void KeywordList::setCaseSensitivity(Qt::CaseSensitivity caseSensitive)
 void KeywordList::initLookupForCaseSensitivity(Qt::CaseSensitivity caseSensitive)
 {
     /**
-     * get right vector to sort, if non-empty, we are done
+     * get right table to build, if already built, we are done
      */
-    auto& vectorToSort =
-        (caseSensitive == Qt::CaseSensitive) ? m_keywordsSortedCaseSensitive : m_keywordsSortedCaseInsensitive;
-    if (!vectorToSort.empty()) {
+    auto& table = (caseSensitive == Qt::CaseSensitive) ? m_caseSensitiveTable : m_caseInsensitiveTable;
+    if (table.isBuilt()) {
         return;
     }
 
-    /**
-     * fill vector with refs to keywords
-     */
-    vectorToSort.reserve(m_keywords.size());
-    for (const auto& keyword : qAsConst(m_keywords)) {
-        vectorToSort.push_back(&keyword);
-    }
-
-    /**
-     * sort with right predicate
-     */
-    std::sort(vectorToSort.begin(), vectorToSort.end(), [caseSensitive](const QStringRef& a, const QStringRef& b) {
-        return a.compare(b, caseSensitive) < 0;
-    });
+    table.build(m_keywords, caseSensitive);
 }
@@ -30,10 +30,47 @@
 
 #include <vector>
 
+class QDataStream;
 class QXmlStreamReader;
 
 namespace ote {
 
+/**
+ * A static, collision-free hash table of keywords, built with the "hash and displace"
+ * scheme: keywords are hashed into small buckets, and each bucket gets a displacement
+ * that moves all of its keywords into slots of their own. A lookup thus hashes the
+ * string once and compares it against a single keyword, by length first.
+ */
+class KeywordTable
+{
+public:
+    void build(const QStringList &keywords, Qt::CaseSensitivity caseSensitive);
+
+    bool isBuilt() const
+    {
+        return m_built;
+    }
+
+    bool contains(const QStringRef &str) const;
+
+private:
+    bool tryBuild(const QVector<QString> &keys, quint64 seed, quint32 tableSize);
+
+    Qt::CaseSensitivity m_caseSensitive = Qt::CaseSensitive;
+    bool m_built = false;
+    quint64 m_seed = 0;
+
+    /**
+     * displacement of each bucket
+     */
+    std::vector<quint32> m_displacements;
+
+    /**
+     * the keywords by slot, case-folded if case-insensitive; empty slots are null strings
+     */
+    std::vector<QString> m_slots;
+};
+
 class KeywordList
 {
 public:
@@ -55,6 +92,11 @@ public:
         return m_keywords;
     }
 
+    Qt::CaseSensitivity caseSensitivity() const
+    {
+        return m_caseSensitive;
+    }
+
     /** Checks if @p str is a keyword in this list. */
     bool contains(const QStringRef &str) const
     {
@@ -65,6 +107,11 @@ public:
     bool contains(const QStringRef &str, Qt::CaseSensitivity caseSensitive) const;
 
     void load(QXmlStreamReader &reader);
+
+    /** Reads/writes the list from/to a definition cache. The lookup tables are rebuilt on load. */
+    void load(QDataStream &stream);
+    void save(QDataStream &stream) const;
+
     void setCaseSensitivity(Qt::CaseSensitivity caseSensitive);
     void initLookupForCaseSensitivity(Qt::CaseSensitivity caseSensitive);
 
@@ -85,14 +132,14 @@ private:
     Qt::CaseSensitivity m_caseSensitive = Qt::CaseSensitive;
 
     /**
-     * case-sensitive sorted string references to m_keywords for lookup
+     * case-sensitive lookup table
      */
-    std::vector<QStringRef> m_keywordsSortedCaseSensitive;
+    KeywordTable m_caseSensitiveTable;
 
     /**
-     * case-insensitive sorted string references to m_keywords for lookup
+     * case-insensitive lookup table
      */
-    std::vector<QStringRef> m_keywordsSortedCaseInsensitive;
+    KeywordTable m_caseInsensitiveTable;
 };
 }
 
@@ -0,0 +1,253 @@
+#include "regexengine.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <atomic>
+
+namespace ote {
+
+namespace {
+
+// PCRE2 reads limits from the start of a pattern. They can only lower the library's limits.
+const QString LIMIT_PREFIX = QStringLiteral("(*LIMIT_MATCH=%1)");
+
+// The cache is cleared when it grows larger than this. Dynamic highlighting rules can create
+// many short-lived patterns.
+const int MAX_CACHE_SIZE = 4096;
+
+int prefixLength(const QString &pattern)
+{
+    if (!pattern.startsWith(QLatin1String("(*LIMIT_MATCH=")))
+        return 0;
+
+    return pattern.indexOf(QLatin1Char(')')) + 1;
+}
+
+struct CacheKey {
+    QString pattern;
+    QRegularExpression::PatternOptions options;
+    int backtrackLimit;
+
+    bool operator==(const CacheKey &other) const
+    {
+        return backtrackLimit == other.backtrackLimit && options == other.options && pattern == other.pattern;
+    }
+};
+
+uint qHash(const CacheKey &key, uint seed = 0)
+{
+    return ::qHash(key.pattern, seed) ^ static_cast<uint>(key.options) ^ static_cast<uint>(key.backtrackLimit);
+}
+
+struct RegexEngineData {
+    ~RegexEngineData();
+
+    QVector<RegexEngine::PatternStatistics> statistics();
+
+    QMutex cacheMutex;
+    QHash<CacheKey, QRegularExpression> cache;
+
+    QMutex statsMutex;
+    QHash<QString, RegexEngine::PatternStatistics> stats;
+
+    std::atomic<quint64> dynamicCacheHits {0};
+    std::atomic<quint64> dynamicCacheMisses {0};
+
+    std::atomic<int> backtrackLimit {1000000};
+    std::atomic<bool> profiling {qEnvironmentVariableIsSet("NQQ_PROFILE_REGEX")};
+};
+
+RegexEngineData::~RegexEngineData()
+{
+    if (!profiling)
+        return;
+
+    const auto all = statistics();
+    qInfo() << "Regex profile, slowest patterns first:";
+    for (const auto &s : all) {
+        qInfo().noquote() << QStringLiteral("%1 ms total, %2 us max, %3 calls, %4 failed: %5")
+                             .arg(s.totalNsecs / 1e6, 0, 'f', 2)
+                             .arg(s.maxNsecs / 1e3, 0, 'f', 1)
+                             .arg(s.calls)
+                             .arg(s.failures)
+                             .arg(s.pattern);
+    }
+    qInfo().noquote() << QStringLiteral("Dynamic pattern cache: %1 hits, %2 misses")
+                         .arg(dynamicCacheHits.load())
+                         .arg(dynamicCacheMisses.load());
+}
+
+Q_GLOBAL_STATIC(RegexEngineData, s_data)
+
+QVector<RegexEngine::PatternStatistics> RegexEngineData::statistics()
+{
+    QVector<RegexEngine::PatternStatistics> all;
+
+    {
+        QMutexLocker lock(&statsMutex);
+        all.reserve(stats.size());
+        for (auto it = stats.constBegin(); it != stats.constEnd(); ++it) {
+            all.push_back(it.value());
+            all.back().pattern = it.key().mid(prefixLength(it.key()));
+        }
+    }
+
+    std::sort(all.begin(), all.end(), [](const RegexEngine::PatternStatistics &a, const RegexEngine::PatternStatistics &b) {
+        return a.totalNsecs > b.totalNsecs;
+    });
+
+    return all;
+}
+
+void record(const QRegularExpression &regex, qint64 nsecs, bool failed)
+{
+    RegexEngineData *d = s_data();
+    QMutexLocker lock(&d->statsMutex);
+
+    auto &s = d->stats[regex.pattern()];
+    s.calls++;
+    s.failures += failed ? 1 : 0;
+    s.totalNsecs += nsecs;
+    s.maxNsecs = std::max(s.maxNsecs, nsecs);
+}
+
+} // namespace
+
+QRegularExpression RegexEngine::compile(const QString &pattern, QRegularExpression::PatternOptions options,
+                                        int backtrackLimit)
+{
+    if (backtrackLimit < 0)
+        backtrackLimit = defaultBacktrackLimit();
+
+    RegexEngineData *d = s_data();
+    const CacheKey key{pattern, options, backtrackLimit};
+
+    {
+        QMutexLocker lock(&d->cacheMutex);
+        const auto it = d->cache.constFind(key);
+        if (it != d->cache.constEnd())
+            return it.value();
+    }
+
+    QRegularExpression regex(backtrackLimit > 0 ? LIMIT_PREFIX.arg(backtrackLimit) + pattern : pattern, options);
+    regex.optimize();
+
+    QMutexLocker lock(&d->cacheMutex);
+    if (d->cache.size() >= MAX_CACHE_SIZE)
+        d->cache.clear();
+    d->cache.insert(key, regex);
+
+    return regex;
+}
+
+QString RegexEngine::pattern(const QRegularExpression &regex)
+{
+    const QString pattern = regex.pattern();
+    return pattern.mid(prefixLength(pattern));
+}
+
+int RegexEngine::patternErrorOffset(const QRegularExpression &regex)
+{
+    const int offset = regex.patternErrorOffset();
+    if (offset < 0)
+        return offset;
+
+    return std::max(0, offset - prefixLength(regex.pattern()));
+}
+
+QRegularExpressionMatch RegexEngine::match(const QRegularExpression &regex, const QString &subject, int offset,
+                                           QRegularExpression::MatchOptions options, MatchStatus *status,
+                                           int timeLimitMs)
+{
+    return match(regex, subject, offset, options, status, timeLimitMs, isProfilingEnabled());
+}
+
+QRegularExpressionMatch RegexEngine::match(const QRegularExpression &regex, const QString &subject, int offset,
+                                           QRegularExpression::MatchOptions options, MatchStatus *status,
+                                           int timeLimitMs, bool profiling)
+{
+    const bool timed = profiling || timeLimitMs > 0;
+
+    QElapsedTimer timer;
+    if (timed)
+        timer.start();
+
+    QRegularExpressionMatch result = regex.match(subject, offset, QRegularExpression::NormalMatch, options);
+
+    // An invalid match of a valid expression means PCRE2 returned an error, i.e. hit a limit.
+    MatchStatus s = (result.isValid() || !regex.isValid()) ? MatchOk : MatchLimitExceeded;
+
+    if (timed) {
+        const qint64 nsecs = timer.nsecsElapsed();
+
+        if (s == MatchOk && timeLimitMs > 0 && nsecs > qint64(timeLimitMs) * 1000000)
+            s = TimeLimitExceeded;
+
+        if (profiling)
+            record(regex, nsecs, s != MatchOk);
+    }
+
+    if (status)
+        *status = s;
+
+    return result;
+}
+
+int RegexEngine::defaultBacktrackLimit()
+{
+    return s_data()->backtrackLimit;
+}
+
+void RegexEngine::setDefaultBacktrackLimit(int limit)
+{
+    s_data()->backtrackLimit = std::max(0, limit);
+}
+
+bool RegexEngine::isProfilingEnabled()
+{
+    return s_data()->profiling;
+}
+
+void RegexEngine::setProfilingEnabled(bool enabled)
+{
+    s_data()->profiling = enabled;
+}
+
+QVector<RegexEngine::PatternStatistics> RegexEngine::statistics()
+{
+    return s_data()->statistics();
+}
+
+void RegexEngine::resetStatistics()
+{
+    RegexEngineData *d = s_data();
+    QMutexLocker lock(&d->statsMutex);
+    d->stats.clear();
+    d->dynamicCacheHits = 0;
+    d->dynamicCacheMisses = 0;
+}
+
+RegexEngine::CacheStatistics RegexEngine::dynamicCacheStatistics()
+{
+    RegexEngineData *d = s_data();
+    CacheStatistics s;
+    s.hits = d->dynamicCacheHits;
+    s.misses = d->dynamicCacheMisses;
+    return s;
+}
+
+void RegexEngine::recordDynamicCacheLookup(bool hit)
+{
+    RegexEngineData *d = s_data();
+    if (hit)
+        d->dynamicCacheHits.fetch_add(1, std::memory_order_relaxed);
+    else
+        d->dynamicCacheMisses.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace ote
@@ -0,0 +1,105 @@
+#ifndef REGEXENGINE_H
+#define REGEXENGINE_H
+
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+namespace ote {
+
+/**
+ * RegexEngine
+ * Execution layer for the regular expressions used by the syntax highlighter and by Find in Files.
+ *
+ * Patterns are compiled once, JIT-optimized immediately and cached, so equal patterns share their
+ * compiled code. Every pattern carries a backtracking limit: a catastrophic pattern fails with
+ * MatchLimitExceeded instead of blocking its thread. Callers may also pass a time limit per match.
+ *
+ * When profiling is enabled (setProfilingEnabled() or the NQQ_PROFILE_REGEX environment variable),
+ * the time spent in each pattern is recorded. A report sorted by total time is printed on exit.
+ *
+ * All functions are thread-safe.
+ */
+class RegexEngine
+{
+public:
+    enum MatchStatus {
+        MatchOk,            // The match ran to completion, whether it found something or not
+        MatchLimitExceeded, // The pattern backtracked more often than its backtracking limit allows
+        TimeLimitExceeded   // The match took longer than the time limit passed to match()
+    };
+
+    struct PatternStatistics {
+        QString pattern;
+        quint64 calls = 0;      // Number of match() calls
+        quint64 failures = 0;   // Number of calls that exceeded a limit
+        qint64 totalNsecs = 0;
+        qint64 maxNsecs = 0;
+    };
+
+    struct CacheStatistics {
+        quint64 hits = 0;
+        quint64 misses = 0;
+    };
+
+    /**
+     * Returns the compiled expression for @p pattern. Calls with the same pattern, options and limit
+     * share the compiled code. The expression is JIT-compiled right away.
+     * @param backtrackLimit Maximum number of backtracking steps per match. -1 uses defaultBacktrackLimit(),
+     *        0 uses PCRE2's built-in limit.
+     */
+    static QRegularExpression compile(const QString &pattern,
+                                      QRegularExpression::PatternOptions options = QRegularExpression::NoPatternOption,
+                                      int backtrackLimit = -1);
+
+    /**
+     * Returns the pattern passed to compile(), without the prefix used to enforce the backtracking limit.
+     */
+    static QString pattern(const QRegularExpression &regex);
+
+    /**
+     * Returns the offset of the pattern error relative to pattern(), or -1 if @p regex is valid.
+     */
+    static int patternErrorOffset(const QRegularExpression &regex);
+
+    /**
+     * Runs @p regex on @p subject starting at @p offset, like QRegularExpression::match().
+     * If a limit was exceeded, @p status tells which one and the returned match has no match.
+     * @param timeLimitMs Matches taking longer than this are reported as TimeLimitExceeded. A single
+     *        match can't be interrupted, so this is meant to stop loops over many matches. 0 disables it.
+     */
+    static QRegularExpressionMatch match(const QRegularExpression &regex, const QString &subject, int offset = 0,
+                                         QRegularExpression::MatchOptions options = QRegularExpression::NoMatchOption,
+                                         MatchStatus *status = nullptr, int timeLimitMs = 0);
+
+    /**
+     * Same as above, with isProfilingEnabled() looked up by the caller. Meant for callers running
+     * many matches in a row, like the highlighter.
+     */
+    static QRegularExpressionMatch match(const QRegularExpression &regex, const QString &subject, int offset,
+                                         QRegularExpression::MatchOptions options, MatchStatus *status,
+                                         int timeLimitMs, bool profiling);
+
+    static int defaultBacktrackLimit();
+    static void setDefaultBacktrackLimit(int limit);
+
+    static bool isProfilingEnabled();
+    static void setProfilingEnabled(bool enabled);
+
+    /**
+     * Returns the recorded statistics of all patterns, sorted by total time spent, slowest first.
+     */
+    static QVector<PatternStatistics> statistics();
+    static void resetStatistics();
+
+    /**
+     * Hit and miss counts of the caches holding the patterns instantiated by dynamic highlighting
+     * rules. These are always recorded, regardless of isProfilingEnabled().
+     */
+    static CacheStatistics dynamicCacheStatistics();
+    static void recordDynamicCacheLookup(bool hit);
+};
+
+} // namespace ote
+
+#endif // REGEXENGINE_H
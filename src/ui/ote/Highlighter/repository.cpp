@@ -30,18 +30,25 @@
 #include "themedata_p.h"
 #include "wildcardmatcher_p.h"
 
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QDebug>
+#include <QDir>
 #include <QDirIterator>
 #include <QFile>
 #include <QFileInfo>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSaveFile>
 
 #ifndef NO_STANDARD_PATHS
 #include <QStandardPaths>
 #endif
 
+#include <algorithm>
 #include <limits>
 
 using namespace ote;
@@ -51,15 +58,78 @@ RepositoryPrivate* RepositoryPrivate::get(Repository* repo)
     return repo->d.get();
 }
 
-Repository::Repository(const QString& dataPath)
+const int Repository::MAX_CONTENT_DETECTION_LENGTH;
+
+namespace {
+
+class WarmUpTask : public QRunnable
+{
+public:
+    WarmUpTask(RepositoryPrivate* repo, QVector<Definition> defs)
+        : m_repo(repo)
+        , m_defs(std::move(defs))
+        , m_generation(repo->m_warmUpGeneration)
+    {
+    }
+
+    void run() override
+    {
+        for (const auto& def : m_defs) {
+            if (m_repo->m_warmUpGeneration != m_generation)
+                return;
+            DefinitionData::get(def)->load();
+        }
+    }
+
+private:
+    RepositoryPrivate* m_repo;
+    QVector<Definition> m_defs;
+    int m_generation;
+};
+
+/**
+ * Whether @p pattern refers to one of its groups by number or name, i.e. backreferences and
+ * subroutine calls. Such references change meaning when the pattern becomes part of a larger one.
+ */
+bool refersToGroups(const QString& pattern)
+{
+    for (int i = 0; i + 1 < pattern.size(); ++i) {
+        const QChar c = pattern.at(i);
+        const QChar next = pattern.at(i + 1);
+
+        if (c == QLatin1Char('\\')) {
+            // \1 to \9, \g{...}, \g1, \k<name>, \k{name} ...
+            if ((next.isDigit() && next != QLatin1Char('0')) || next == QLatin1Char('g') || next == QLatin1Char('k'))
+                return true;
+            ++i; // Skip the escaped character
+        } else if (c == QLatin1Char('(') && next == QLatin1Char('?') && i + 2 < pattern.size()) {
+            // (?1), (?-1), (?+1), (?R), (?&name), (?P=name), (?P>name)
+            const QChar kind = pattern.at(i + 2);
+            const QChar after = i + 3 < pattern.size() ? pattern.at(i + 3) : QChar();
+            if (kind.isDigit() || kind == QLatin1Char('R') || kind == QLatin1Char('&') ||
+                    ((kind == QLatin1Char('-') || kind == QLatin1Char('+')) && after.isDigit()) ||
+                    (kind == QLatin1Char('P') && (after == QLatin1Char('=') || after == QLatin1Char('>'))))
+                return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+Repository::Repository(const QString& dataPath, const QString& cachePath)
     : d(new RepositoryPrivate)
 {
+    d->m_warmUpPool.setMaxThreadCount(1);
     d->m_customSearchPaths.append(dataPath);
+    d->m_cachePath = cachePath;
     d->load(this);
 }
 
 Repository::~Repository()
 {
+    d->stopWarmUp();
+
     // reset repo so we can detect in still alive definition instances
     // that the repo was deleted
     foreach (const auto& def, d->m_sortedDefs)
@@ -90,23 +160,31 @@ Definition Repository::definitionForFileName(const QString& fileName) const
     const auto name = fi.fileName();
 
     QVector<Definition> candidates;
-    for (auto it = d->m_defs.constBegin(); it != d->m_defs.constEnd(); ++it) {
-        auto def = it.value();
-        foreach (const auto& pattern, def.extensions()) {
-            if (WildcardMatcher::exactMatch(name, pattern)) {
+    const auto addCandidates = [&candidates](const QVector<Definition>& defs) {
+        for (const auto& def : defs) {
+            if (!candidates.contains(def))
                 candidates.push_back(def);
-                break;
-            }
         }
+    };
+
+    addCandidates(d->m_exactNames.value(name));
+
+    // "*.ext" patterns: every suffix of the name starting at a '.'
+    for (int dot = name.indexOf(QLatin1Char('.')); dot != -1; dot = name.indexOf(QLatin1Char('.'), dot + 1)) {
+        const auto it = d->m_suffixes.constFind(name.mid(dot));
+        if (it != d->m_suffixes.constEnd())
+            addCandidates(it.value());
     }
 
-    for (const auto& det : d->m_fileNameDetections) {
-        if (det.fileNames.contains(name)) {
-            candidates.push_back(det.def);
-            break;
-        }
+    for (const auto& glob : d->m_globs) {
+        if (!candidates.contains(glob.second) && WildcardMatcher::exactMatch(name, glob.first))
+            candidates.push_back(glob.second);
     }
 
+    const auto detected = d->m_detectedFileNames.constFind(name);
+    if (detected != d->m_detectedFileNames.constEnd())
+        candidates.push_back(detected.value());
+
     return bestCandidate(candidates);
 }
 
@@ -128,12 +206,22 @@ Definition Repository::definitionForMimeType(const QString& mimeType) const
 
 Definition Repository::definitionForContent(const QString& content) const
 {
-    QString firstLine = content.mid(0, content.indexOf('\n'));
+    // Only a bounded part of the first line is considered, however long the content is.
+    QStringRef firstLine = content.leftRef(MAX_CONTENT_DETECTION_LENGTH);
+    const int newline = firstLine.indexOf('\n');
+    if (newline >= 0)
+        firstLine = firstLine.left(newline);
     // FIXME: Test firstLine corner cases, actually get empty line, etc
 
+    if (d->m_contentPattern.isValid() && !d->m_contentPattern.match(firstLine).hasMatch() &&
+            std::none_of(d->m_uncombinedContentRules.cbegin(), d->m_uncombinedContentRules.cend(),
+                         [&firstLine](const QRegularExpression& rule) { return rule.match(firstLine).hasMatch(); }))
+        return Definition();
+
+    // Some rule matched. The first detection with a matching rule wins.
     for (const auto& cd : d->m_contentDetections) {
         for (const auto& rule : cd.rules) {
-            if (firstLine.contains(rule))
+            if (rule.match(firstLine).hasMatch())
                 return cd.def;
         }
     }
@@ -224,6 +312,73 @@ void RepositoryPrivate::load(Repository* repo)
     // load content detection rules. Syntax definitions need to be loaded by this time
     foreach (const auto& path, m_customSearchPaths)
         loadContentDetectionFile(path);
+
+    buildFileNameIndex();
+    buildContentPattern();
+}
+
+void RepositoryPrivate::buildContentPattern()
+{
+    QStringList alternatives;
+    m_uncombinedContentRules.clear();
+    for (auto& cd : m_contentDetections) {
+        const auto end = std::remove_if(cd.rules.begin(), cd.rules.end(), [&cd](const QRegularExpression& rule) {
+            if (rule.isValid())
+                return false;
+            qDebug() << "Invalid content detection rule for" << cd.def.name() << ":" << rule.errorString();
+            return true;
+        });
+        cd.rules.erase(end, cd.rules.end());
+
+        for (const auto& rule : cd.rules) {
+            if (refersToGroups(rule.pattern()))
+                m_uncombinedContentRules.push_back(rule);
+            else
+                alternatives.push_back(QStringLiteral("(?:") + rule.pattern() + QLatin1Char(')'));
+        }
+    }
+
+    // An empty pattern would match everything.
+    m_contentPattern = QRegularExpression(alternatives.isEmpty() ? QStringLiteral("(?!)") : alternatives.join('|'));
+
+    // Valid rules may still not combine, e.g. when two of them use the same group name. The rules are
+    // then only tried one by one.
+    if (!m_contentPattern.isValid()) {
+        qDebug() << "Content detection rules can't be combined:" << m_contentPattern.errorString();
+        return;
+    }
+    m_contentPattern.optimize();
+}
+
+void RepositoryPrivate::buildFileNameIndex()
+{
+    m_exactNames.clear();
+    m_suffixes.clear();
+    m_globs.clear();
+    m_detectedFileNames.clear();
+
+    const auto isWildcard = [](QChar c) { return c == QLatin1Char('*') || c == QLatin1Char('?'); };
+
+    for (const auto& def : m_sortedDefs) {
+        foreach (const auto& pattern, def.extensions()) {
+            if (std::none_of(pattern.constBegin(), pattern.constEnd(), isWildcard)) {
+                m_exactNames[pattern].push_back(def);
+            } else if (pattern.startsWith(QLatin1String("*.")) &&
+                       std::none_of(pattern.constBegin() + 1, pattern.constEnd(), isWildcard)) {
+                m_suffixes[pattern.mid(1)].push_back(def);
+            } else {
+                m_globs.push_back(qMakePair(pattern, def));
+            }
+        }
+    }
+
+    // the first detection listing a file name wins
+    for (const auto& det : m_fileNameDetections) {
+        for (const auto& name : det.fileNames) {
+            if (!m_detectedFileNames.contains(name))
+                m_detectedFileNames.insert(name, det.def);
+        }
+    }
 }
 
 void RepositoryPrivate::loadContentDetectionFile(const QString& path)
@@ -274,24 +429,72 @@ void RepositoryPrivate::loadSyntaxFolder(Repository* repo, const QString& path)
     if (loadSyntaxFolderFromIndex(repo, path))
         return;
 
+    const auto defs = loadSyntaxFolderFromXml(repo, path);
+    for (const auto& def : defs)
+        addDefinition(def);
+
+    // index the folder now, so the XML files don't need to be parsed again on the next start
+    const auto indexFileName = cachedIndexFileName(path);
+    if (!indexFileName.isEmpty() && !defs.isEmpty())
+        saveSyntaxIndex(defs, indexFileName);
+}
+
+QVector<Definition> RepositoryPrivate::loadSyntaxFolderFromXml(Repository* repo, const QString& path)
+{
+    QVector<Definition> defs;
     QDirIterator it(path, QStringList() << QLatin1String("*.xml"), QDir::Files);
     while (it.hasNext()) {
         Definition def;
         auto defData = DefinitionData::get(def);
         defData->repo = repo;
         if (defData->loadMetaData(it.next()))
-            addDefinition(def);
+            defs.push_back(def);
     }
+    return defs;
 }
 
 bool RepositoryPrivate::loadSyntaxFolderFromIndex(Repository* repo, const QString& path)
 {
-    QFile indexFile(path + QLatin1String("/index.katesyntax"));
+    // the index shipped with the folder (generated at build time for the bundled definitions),
+    // or the one generated on first use otherwise
+    if (loadSyntaxIndex(repo, path, path + QLatin1String("/index.katesyntax"), false))
+        return true;
+
+    const auto indexFileName = cachedIndexFileName(path);
+    return !indexFileName.isEmpty() && loadSyntaxIndex(repo, path, indexFileName, true);
+}
+
+bool RepositoryPrivate::loadSyntaxIndex(Repository* repo, const QString& path, const QString& indexFileName,
+                                        bool checkModificationTimes)
+{
+    QFile indexFile(indexFileName);
     if (!indexFile.open(QFile::ReadOnly))
         return false;
 
     const auto indexDoc(QJsonDocument::fromBinaryData(indexFile.readAll()));
     const auto index = indexDoc.object();
+    if (index.isEmpty())
+        return false;
+
+    // The index is only used if it still describes the folder's XML files. An edit that keeps a
+    // file's size is only noticed by its modification time, which the bundled index can't rely on:
+    // copying the folder at install time doesn't preserve them.
+    int fileCount = 0;
+    QDirIterator files(path, QStringList() << QLatin1String("*.xml"), QDir::Files);
+    while (files.hasNext()) {
+        files.next();
+        const auto entry = index.value(files.fileName()).toObject();
+        const auto info = files.fileInfo();
+        if (entry.isEmpty() || entry.value(QLatin1String("fileSize")).toDouble() != info.size())
+            return false;
+        if (checkModificationTimes &&
+                entry.value(QLatin1String("lastModified")).toDouble() != info.lastModified().toMSecsSinceEpoch())
+            return false;
+        ++fileCount;
+    }
+    if (fileCount != index.size())
+        return false;
+
     for (auto it = index.begin(); it != index.end(); ++it) {
         if (!it.value().isObject())
             continue;
@@ -306,6 +509,36 @@ bool RepositoryPrivate::loadSyntaxFolderFromIndex(Repository* repo, const QStrin
     return true;
 }
 
+QString RepositoryPrivate::cachedIndexFileName(const QString& path) const
+{
+    if (m_cachePath.isEmpty())
+        return QString();
+
+    const auto hash = QCryptographicHash::hash(QFileInfo(path).absoluteFilePath().toUtf8(), QCryptographicHash::Sha1);
+    return m_cachePath + QLatin1Char('/') + QString::fromLatin1(hash.toHex()) + QLatin1String(".katesyntax");
+}
+
+bool RepositoryPrivate::saveSyntaxIndex(const QVector<Definition>& defs, const QString& indexFileName)
+{
+    QJsonObject index;
+    for (const auto& def : defs) {
+        const auto defData = DefinitionData::get(def);
+        const QFileInfo info(defData->fileName);
+        auto entry = defData->saveMetaData();
+        entry.insert(QLatin1String("fileSize"), double(info.size()));
+        entry.insert(QLatin1String("lastModified"), double(info.lastModified().toMSecsSinceEpoch()));
+        index.insert(info.fileName(), entry);
+    }
+
+    QDir().mkpath(QFileInfo(indexFileName).absolutePath());
+
+    QSaveFile file(indexFileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(QJsonDocument(index).toBinaryData());
+    return file.commit();
+}
+
 void RepositoryPrivate::addDefinition(const Definition& def)
 {
     const auto it = m_defs.constFind(def.name());
@@ -350,6 +583,7 @@ void RepositoryPrivate::addTheme(const Theme& theme)
 
 quint16 RepositoryPrivate::foldingRegionId(const QString& defName, const QString& foldName)
 {
+    QMutexLocker lock(&m_loadMutex);
     const auto it = m_foldingRegionIds.constFind(qMakePair(defName, foldName));
     if (it != m_foldingRegionIds.constEnd())
         return it.value();
@@ -357,15 +591,44 @@ quint16 RepositoryPrivate::foldingRegionId(const QString& defName, const QString
     return m_foldingRegionId;
 }
 
+QString RepositoryPrivate::foldingRegionName(quint16 id) const
+{
+    QMutexLocker lock(&m_loadMutex);
+    for (auto it = m_foldingRegionIds.constBegin(); it != m_foldingRegionIds.constEnd(); ++it) {
+        if (it.value() == id)
+            return it.key().second;
+    }
+    return QString();
+}
+
 quint16 RepositoryPrivate::nextFormatId()
 {
     Q_ASSERT(m_formatId < std::numeric_limits<quint16>::max());
     return ++m_formatId;
 }
 
+void Repository::warmUp(const QVector<Definition>& defs)
+{
+    QVector<Definition> pending;
+    for (const auto& def : defs) {
+        if (def.isValid() && !DefinitionData::get(def)->loaded && !pending.contains(def))
+            pending.push_back(def);
+    }
+
+    if (!pending.isEmpty())
+        d->m_warmUpPool.start(new WarmUpTask(d.get(), std::move(pending)));
+}
+
+void RepositoryPrivate::stopWarmUp()
+{
+    ++m_warmUpGeneration;
+    m_warmUpPool.waitForDone();
+}
+
 void Repository::reload()
 {
     qDebug() << "Reloading syntax definitions!";
+    d->stopWarmUp();
     foreach (const auto& def, d->m_sortedDefs)
         DefinitionData::get(def)->clear();
     d->m_defs.clear();
@@ -379,6 +642,9 @@ void Repository::reload()
     d->m_formatId = 0;
 
     d->m_contentDetections.clear();
+    d->m_contentPattern = QRegularExpression();
+    d->m_uncombinedContentRules.clear();
+    d->m_fileNameDetections.clear();
 
     d->load(this);
 }
@@ -393,3 +659,13 @@ QVector<QString> Repository::customSearchPaths() const
 {
     return d->m_customSearchPaths;
 }
+
+void Repository::setCachePath(const QString& path)
+{
+    d->m_cachePath = path;
+}
+
+QString Repository::cachePath() const
+{
+    return d->m_cachePath;
+}
@@ -134,8 +134,11 @@ public:
      * definition, which is a moderately expensive operation, it's therefore
      * recommended to keep a single instance of Repository around as long
      * as you need highlighting in your application.
+     * If @p cachePath is not empty, the meta data of syntax folders without
+     * an up-to-date index.katesyntax is indexed there on first use, and
+     * loaded Definition%s are cached there as well (see setCachePath()).
      */
-    Repository(const QString &dataPath);
+    Repository(const QString &dataPath, const QString &cachePath = QString());
     ~Repository();
 
     /**
@@ -174,10 +177,15 @@ public:
 
     /**
      * Returns the best matching Definition for the string @p content.
-     * The match is performed based on the first non-empty line.
+     * The match is performed based on the first line, of which only the first
+     * MAX_CONTENT_DETECTION_LENGTH characters are considered. Passing just the
+     * beginning of a document is enough.
      */
     Definition definitionForContent(const QString& content) const;
 
+    /** The number of characters of the first line definitionForContent() looks at. */
+    static const int MAX_CONTENT_DETECTION_LENGTH = 1024;
+
     /**
      * Returns all available Definition%s.
      * Definition%ss are ordered by translated section and translated names,
@@ -215,6 +223,14 @@ public:
      */
     Theme defaultTheme(DefaultTheme t = LightTheme) const;
 
+    /**
+     * Loads @p defs, and the definitions they include, on a background thread in the given
+     * order, so that highlighting a document of one of these languages doesn't have to parse
+     * its definition first. Definitions that are needed before they have been warmed up are
+     * still loaded on demand. Calls queue up behind each other.
+     */
+    void warmUp(const QVector<Definition> &defs);
+
     /**
      * Reloads the repository.
      * This is a moderately expensive operations and should thus only be
@@ -248,6 +264,22 @@ public:
      */
     QVector<QString> customSearchPaths() const;
 
+    /**
+     * Sets the directory of the binary cache of loaded Definition%s.
+     * A Definition is loaded from the cache if the cache entry was created
+     * from the same version of its XML file, and is added to the cache after
+     * loading the XML file otherwise.
+     * By default, the path is empty and the cache is disabled.
+     */
+    void setCachePath(const QString &path);
+
+    /**
+     * Returns the directory of the binary cache of loaded Definition%s.
+     *
+     * @see setCachePath()
+     */
+    QString cachePath() const;
+
 private:
     Q_DISABLE_COPY(Repository)
     friend class RepositoryPrivate;
@@ -25,8 +25,12 @@
 #define KSYNTAXHIGHLIGHTING_REPOSITORY_P_H
 
 #include <QHash>
+#include <QMutex>
 #include <QVector>
 #include <QRegularExpression>
+#include <QThreadPool>
+
+#include <atomic>
 
 #include "definition.h"
 
@@ -59,6 +63,17 @@ public:
     void load(Repository *repo);
     void loadSyntaxFolder(Repository *repo, const QString &path);
     bool loadSyntaxFolderFromIndex(Repository *repo, const QString &path);
+    bool loadSyntaxIndex(Repository *repo, const QString &path, const QString &indexFileName,
+                         bool checkModificationTimes);
+    QString cachedIndexFileName(const QString &path) const;
+
+    /**
+     * Reading the meta data of a syntax folder from its XML files, and writing it to an
+     * index file. Also used by the syntaxindexer tool to index the bundled definitions at
+     * build time.
+     */
+    static QVector<Definition> loadSyntaxFolderFromXml(Repository *repo, const QString &path);
+    static bool saveSyntaxIndex(const QVector<Definition> &defs, const QString &indexFileName);
 
     void addDefinition(const Definition &def);
 
@@ -66,19 +81,56 @@ public:
     void addTheme(const Theme &theme);
     void loadContentDetectionFile(const QString& file);
 
+    /**
+     * Precompiles the extension patterns of all definitions and the file name detections
+     * for definitionForFileName(): plain names are looked up in m_exactNames, "*.ext"
+     * patterns in m_suffixes, and only the remaining true globs are matched one by one.
+     */
+    void buildFileNameIndex();
+
+    /**
+     * Combines the rules of all content detections into m_contentPattern, so that
+     * definitionForContent() rejects content that matches no rule in a single pass.
+     * Invalid rules are dropped. Rules with backreferences or subroutine calls are kept in
+     * m_uncombinedContentRules instead. If the rules can't be combined, m_contentPattern is
+     * left invalid and all rules are tried one by one.
+     */
+    void buildContentPattern();
+
+    /**
+     * Abandons the definitions queued by Repository::warmUp() and waits for the one currently
+     * being loaded, e.g. before the definitions are reloaded.
+     */
+    void stopWarmUp();
+
     quint16 foldingRegionId(const QString &defName, const QString &foldName);
+    QString foldingRegionName(quint16 id) const;
     quint16 nextFormatId();
 
     QVector<QString> m_customSearchPaths;
+    QString m_cachePath;
 
     QHash<QString, Definition> m_defs;
     QVector<Definition> m_sortedDefs;
 
     QVector<ContentDetection> m_contentDetections;
+    QRegularExpression m_contentPattern;  // Matches if any rule of m_contentDetections matches
+    QVector<QRegularExpression> m_uncombinedContentRules; // Rules that aren't part of m_contentPattern
     QVector<FileNameDetection> m_fileNameDetections;
 
+    QHash<QString, QVector<Definition>> m_exactNames;
+    QHash<QString, QVector<Definition>> m_suffixes;  // Keyed by the suffix including its leading '.'
+    QVector<QPair<QString, Definition>> m_globs;
+    QHash<QString, Definition> m_detectedFileNames;
+
     QVector<Theme> m_themes;
 
+    // Held while loading a definition, which also assigns the format and folding region ids
+    // below. Recursive since resolving includes loads the included definitions.
+    mutable QMutex m_loadMutex{QMutex::Recursive};
+    QThreadPool m_warmUpPool;               // Loads definitions for warmUp(), one at a time
+    std::atomic<int> m_warmUpGeneration{0}; // Incremented by stopWarmUp()
+
     QHash<QPair<QString, QString>, quint16> m_foldingRegionIds;
     quint16 m_foldingRegionId = 0;
     quint16 m_formatId = 0;
@@ -24,15 +24,23 @@
 
 #include "context_p.h"
 #include "definition_p.h"
+#include "regexengine.h"
+#include "repository_p.h"
 #include "rule_p.h"
 #include "xml_p.h"
 
+#include <QDataStream>
 #include <QDebug>
 #include <QString>
 #include <QXmlStreamReader>
 
+#include <algorithm>
+
 using namespace ote;
 
+// number of instantiations of a dynamic RegExpr kept compiled
+static const std::size_t DYNAMIC_CACHE_SIZE = 8;
+
 static bool isOctalChar(QChar c)
 {
     return c.isNumber() && c != QLatin1Char('9') && c != QLatin1Char('8');
@@ -162,49 +170,152 @@ bool Rule::doLoad(QXmlStreamReader& reader)
     return true;
 }
 
+namespace {
+
+struct RuleType {
+    const char* name; // element name in the XML files
+    Rule* (*create)();
+};
+
+// The index of each type is stored in definition caches, only append to this table.
+const RuleType RULE_TYPES[] = {
+    {"AnyChar",          []() -> Rule* { return new AnyChar; }},
+    {"DetectChar",       []() -> Rule* { return new DetectChar; }},
+    {"Detect2Chars",     []() -> Rule* { return new Detect2Char; }},
+    {"DetectIdentifier", []() -> Rule* { return new DetectIdentifier; }},
+    {"DetectSpaces",     []() -> Rule* { return new DetectSpaces; }},
+    {"Float",            []() -> Rule* { return new Float; }},
+    {"Int",              []() -> Rule* { return new Int; }},
+    {"HlCChar",          []() -> Rule* { return new HlCChar; }},
+    {"HlCHex",           []() -> Rule* { return new HlCHex; }},
+    {"HlCOct",           []() -> Rule* { return new HlCOct; }},
+    {"HlCStringChar",    []() -> Rule* { return new HlCStringChar; }},
+    {"IncludeRules",     []() -> Rule* { return new IncludeRules; }},
+    {"keyword",          []() -> Rule* { return new KeywordListRule; }},
+    {"LineContinue",     []() -> Rule* { return new LineContinue; }},
+    {"RangeDetect",      []() -> Rule* { return new RangeDetect; }},
+    {"RegExpr",          []() -> Rule* { return new RegExpr; }},
+    {"StringDetect",     []() -> Rule* { return new StringDetect; }},
+    {"WordDetect",       []() -> Rule* { return new WordDetect; }},
+};
+
+const int RULE_TYPE_COUNT = sizeof(RULE_TYPES) / sizeof(RULE_TYPES[0]);
+
+QString foldingRegionName(const Definition& def, const FoldingRegion& region)
+{
+    if (!region.isValid())
+        return QString();
+
+    const auto defData = DefinitionData::get(def);
+    return RepositoryPrivate::get(defData->repo)->foldingRegionName(region.id());
+}
+
+}
+
 Rule::Ptr Rule::create(const QStringRef& name)
 {
-    Rule* rule = nullptr;
-    if (name == QLatin1String("AnyChar"))
-        rule = new AnyChar;
-    else if (name == QLatin1String("DetectChar"))
-        rule = new DetectChar;
-    else if (name == QLatin1String("Detect2Chars"))
-        rule = new Detect2Char;
-    else if (name == QLatin1String("DetectIdentifier"))
-        rule = new DetectIdentifier;
-    else if (name == QLatin1String("DetectSpaces"))
-        rule = new DetectSpaces;
-    else if (name == QLatin1String("Float"))
-        rule = new Float;
-    else if (name == QLatin1String("Int"))
-        rule = new Int;
-    else if (name == QLatin1String("HlCChar"))
-        rule = new HlCChar;
-    else if (name == QLatin1String("HlCHex"))
-        rule = new HlCHex;
-    else if (name == QLatin1String("HlCOct"))
-        rule = new HlCOct;
-    else if (name == QLatin1String("HlCStringChar"))
-        rule = new HlCStringChar;
-    else if (name == QLatin1String("IncludeRules"))
-        rule = new IncludeRules;
-    else if (name == QLatin1String("keyword"))
-        rule = new KeywordListRule;
-    else if (name == QLatin1String("LineContinue"))
-        rule = new LineContinue;
-    else if (name == QLatin1String("RangeDetect"))
-        rule = new RangeDetect;
-    else if (name == QLatin1String("RegExpr"))
-        rule = new RegExpr;
-    else if (name == QLatin1String("StringDetect"))
-        rule = new StringDetect;
-    else if (name == QLatin1String("WordDetect"))
-        rule = new WordDetect;
-    else
-        qWarning() << "Unknown rule type:" << name;
+    for (int type = 0; type < RULE_TYPE_COUNT; ++type) {
+        if (name == QLatin1String(RULE_TYPES[type].name))
+            return create(type);
+    }
+
+    qWarning() << "Unknown rule type:" << name;
+    return Ptr();
+}
+
+Rule::Ptr Rule::create(int type)
+{
+    if (type < 0 || type >= RULE_TYPE_COUNT)
+        return Ptr();
+
+    Ptr rule(RULE_TYPES[type].create());
+    rule->m_type = type;
+    return rule;
+}
+
+Rule::Ptr Rule::create(QDataStream& stream)
+{
+    qint32 type = -1;
+    stream >> type;
+    return create(type);
+}
+
+bool Rule::load(QDataStream& stream)
+{
+    QString beginRegion;
+    QString endRegion;
+    qint32 column = -1;
+
+    m_context.load(stream);
+    stream >> m_attribute >> m_firstNonSpace >> m_lookAhead >> column >> beginRegion >> endRegion;
+    m_column = column;
+
+    if (!beginRegion.isEmpty())
+        m_beginRegion = FoldingRegion(FoldingRegion::Begin, DefinitionData::get(m_def.definition())->foldingRegionId(beginRegion));
+    if (!endRegion.isEmpty())
+        m_endRegion = FoldingRegion(FoldingRegion::End, DefinitionData::get(m_def.definition())->foldingRegionId(endRegion));
 
-    return Ptr(rule);
+    const bool result = doLoad(stream);
+    return result && stream.status() == QDataStream::Ok;
+}
+
+void Rule::save(QDataStream& stream) const
+{
+    stream << qint32(m_type);
+    m_context.save(stream);
+    stream << m_attribute << m_firstNonSpace << m_lookAhead << qint32(m_column)
+           << foldingRegionName(definition(), m_beginRegion) << foldingRegionName(definition(), m_endRegion);
+    doSave(stream);
+}
+
+bool Rule::doLoad(QDataStream& stream)
+{
+    Q_UNUSED(stream);
+    return true;
+}
+
+void Rule::doSave(QDataStream& stream) const
+{
+    Q_UNUSED(stream);
+}
+
+QString Rule::parameter() const
+{
+    return QString();
+}
+
+QString Rule::description() const
+{
+    QString result = m_type >= 0 ? QString::fromLatin1(RULE_TYPES[m_type].name) : QStringLiteral("Rule");
+
+    const auto param = parameter();
+    if (!param.isEmpty())
+        result += QLatin1Char(' ') + param;
+    if (!m_attribute.isEmpty())
+        result += QLatin1String(" [") + m_attribute + QLatin1Char(']');
+    return result;
+}
+
+bool Rule::firstCharacters(std::bitset<128>& chars) const
+{
+    Q_UNUSED(chars);
+    return false;
+}
+
+void Rule::addFirstCharacter(std::bitset<128>& chars, QChar c, Qt::CaseSensitivity caseSensitivity)
+{
+    if (caseSensitivity == Qt::CaseSensitive) {
+        if (c.unicode() < 128)
+            chars.set(c.unicode());
+        return;
+    }
+
+    // Same folding as QString::compare(), which is what the rules use to match
+    const auto folded = c.toCaseFolded();
+    for (int i = 0; i < 128; ++i) {
+        if (QChar(i).toCaseFolded() == folded)
+            chars.set(i);
+    }
 }
 
 bool Rule::isWordDelimiter(QChar c) const
@@ -221,6 +332,22 @@ bool AnyChar::doLoad(QXmlStreamReader& reader)
     return !m_chars.isEmpty();
 }
 
+bool AnyChar::doLoad(QDataStream& stream)
+{
+    stream >> m_chars;
+    return !m_chars.isEmpty();
+}
+
+void AnyChar::doSave(QDataStream& stream) const
+{
+    stream << m_chars;
+}
+
+QString AnyChar::parameter() const
+{
+    return m_chars;
+}
+
 MatchResult AnyChar::doMatch(const QString& text, int offset, const QStringList&) const
 {
     if (m_chars.contains(text.at(offset)))
@@ -228,6 +355,13 @@ MatchResult AnyChar::doMatch(const QString& text, int offset, const QStringList&
     return offset;
 }
 
+bool AnyChar::firstCharacters(std::bitset<128>& chars) const
+{
+    for (const auto c : m_chars)
+        addFirstCharacter(chars, c, Qt::CaseSensitive);
+    return true;
+}
+
 bool DetectChar::doLoad(QXmlStreamReader& reader)
 {
     const auto s = reader.attributes().value(QStringLiteral("char"));
@@ -241,6 +375,24 @@ bool DetectChar::doLoad(QXmlStreamReader& reader)
     return true;
 }
 
+bool DetectChar::doLoad(QDataStream& stream)
+{
+    qint32 captureIndex = 0;
+    stream >> m_char >> m_dynamic >> captureIndex;
+    m_captureIndex = captureIndex;
+    return true;
+}
+
+void DetectChar::doSave(QDataStream& stream) const
+{
+    stream << m_char << m_dynamic << qint32(m_captureIndex);
+}
+
+QString DetectChar::parameter() const
+{
+    return m_dynamic ? QStringLiteral("%%%1").arg(m_captureIndex) : QString(m_char);
+}
+
 MatchResult DetectChar::doMatch(const QString& text, int offset, const QStringList& captures) const
 {
     if (m_dynamic) {
@@ -256,6 +408,14 @@ MatchResult DetectChar::doMatch(const QString& text, int offset, const QStringLi
     return offset;
 }
 
+bool DetectChar::firstCharacters(std::bitset<128>& chars) const
+{
+    if (m_dynamic)
+        return false;
+    addFirstCharacter(chars, m_char, Qt::CaseSensitive);
+    return true;
+}
+
 bool Detect2Char::doLoad(QXmlStreamReader& reader)
 {
     const auto s1 = reader.attributes().value(QStringLiteral("char"));
@@ -267,6 +427,22 @@ bool Detect2Char::doLoad(QXmlStreamReader& reader)
     return true;
 }
 
+bool Detect2Char::doLoad(QDataStream& stream)
+{
+    stream >> m_char1 >> m_char2;
+    return true;
+}
+
+void Detect2Char::doSave(QDataStream& stream) const
+{
+    stream << m_char1 << m_char2;
+}
+
+QString Detect2Char::parameter() const
+{
+    return QString(m_char1) + m_char2;
+}
+
 MatchResult Detect2Char::doMatch(const QString& text, int offset, const QStringList&) const
 {
     if (text.size() - offset < 2)
@@ -276,6 +452,12 @@ MatchResult Detect2Char::doMatch(const QString& text, int offset, const QStringL
     return offset;
 }
 
+bool Detect2Char::firstCharacters(std::bitset<128>& chars) const
+{
+    addFirstCharacter(chars, m_char1, Qt::CaseSensitive);
+    return true;
+}
+
 MatchResult DetectIdentifier::doMatch(const QString& text, int offset, const QStringList&) const
 {
     if (!text.at(offset).isLetter() && text.at(offset) != QLatin1Char('_'))
@@ -290,6 +472,15 @@ MatchResult DetectIdentifier::doMatch(const QString& text, int offset, const QSt
     return text.size();
 }
 
+bool DetectIdentifier::firstCharacters(std::bitset<128>& chars) const
+{
+    for (int c = 0; c < 128; ++c) {
+        if (QChar(c).isLetter() || c == '_')
+            chars.set(c);
+    }
+    return true;
+}
+
 MatchResult DetectSpaces::doMatch(const QString& text, int offset, const QStringList&) const
 {
     while (offset < text.size() && text.at(offset).isSpace())
@@ -297,6 +488,15 @@ MatchResult DetectSpaces::doMatch(const QString& text, int offset, const QString
     return offset;
 }
 
+bool DetectSpaces::firstCharacters(std::bitset<128>& chars) const
+{
+    for (int c = 0; c < 128; ++c) {
+        if (QChar(c).isSpace())
+            chars.set(c);
+    }
+    return true;
+}
+
 MatchResult Float::doMatch(const QString& text, int offset, const QStringList&) const
 {
     if (offset > 0 && !isWordDelimiter(text.at(offset - 1)))
@@ -334,6 +534,14 @@ MatchResult Float::doMatch(const QString& text, int offset, const QStringList&)
     return expOffset;
 }
 
+bool Float::firstCharacters(std::bitset<128>& chars) const
+{
+    for (int c = '0'; c <= '9'; ++c)
+        chars.set(c);
+    chars.set('.');
+    return true;
+}
+
 MatchResult HlCChar::doMatch(const QString& text, int offset, const QStringList&) const
 {
     if (text.size() < offset + 3)
@@ -358,6 +566,12 @@ MatchResult HlCChar::doMatch(const QString& text, int offset, const QStringList&
     return offset;
 }
 
+bool HlCChar::firstCharacters(std::bitset<128>& chars) const
+{
+    chars.set('\'');
+    return true;
+}
+
 MatchResult HlCHex::doMatch(const QString& text, int offset, const QStringList&) const
 {
     if (offset > 0 && !isWordDelimiter(text.at(offset - 1)))
@@ -382,6 +596,12 @@ MatchResult HlCHex::doMatch(const QString& text, int offset, const QStringList&)
     return offset;
 }
 
+bool HlCHex::firstCharacters(std::bitset<128>& chars) const
+{
+    chars.set('0');
+    return true;
+}
+
 MatchResult HlCOct::doMatch(const QString& text, int offset, const QStringList&) const
 {
     if (offset > 0 && !isWordDelimiter(text.at(offset - 1)))
@@ -403,11 +623,23 @@ MatchResult HlCOct::doMatch(const QString& text, int offset, const QStringList&)
     return offset;
 }
 
+bool HlCOct::firstCharacters(std::bitset<128>& chars) const
+{
+    chars.set('0');
+    return true;
+}
+
 MatchResult HlCStringChar::doMatch(const QString& text, int offset, const QStringList&) const
 {
     return matchEscapedChar(text, offset);
 }
 
+bool HlCStringChar::firstCharacters(std::bitset<128>& chars) const
+{
+    chars.set('\\');
+    return true;
+}
+
 QString IncludeRules::contextName() const
 {
     return m_contextName;
@@ -437,6 +669,22 @@ bool IncludeRules::doLoad(QXmlStreamReader& reader)
     return !m_contextName.isEmpty() || !m_defName.isEmpty();
 }
 
+bool IncludeRules::doLoad(QDataStream& stream)
+{
+    stream >> m_contextName >> m_defName >> m_includeAttribute;
+    return true;
+}
+
+void IncludeRules::doSave(QDataStream& stream) const
+{
+    stream << m_contextName << m_defName << m_includeAttribute;
+}
+
+QString IncludeRules::parameter() const
+{
+    return m_defName.isEmpty() ? m_contextName : m_contextName + QLatin1String("##") + m_defName;
+}
+
 MatchResult IncludeRules::doMatch(const QString& text, int offset, const QStringList&) const
 {
     Q_UNUSED(text);
@@ -454,6 +702,13 @@ MatchResult Int::doMatch(const QString& text, int offset, const QStringList&) co
     return offset;
 }
 
+bool Int::firstCharacters(std::bitset<128>& chars) const
+{
+    for (int c = '0'; c <= '9'; ++c)
+        chars.set(c);
+    return true;
+}
+
 bool KeywordListRule::doLoad(QXmlStreamReader& reader)
 {
     /**
@@ -482,6 +737,32 @@ bool KeywordListRule::doLoad(QXmlStreamReader& reader)
     return !m_keywordList->isEmpty();
 }
 
+bool KeywordListRule::doLoad(QDataStream& stream)
+{
+    QString listName;
+    qint32 caseSensitivity = Qt::CaseSensitive;
+    stream >> listName >> m_hasCaseSensitivityOverride >> caseSensitivity;
+    m_caseSensitivityOverride = static_cast<Qt::CaseSensitivity>(caseSensitivity);
+
+    m_keywordList = DefinitionData::get(definition())->keywordList(listName);
+    if (!m_keywordList)
+        return false;
+
+    if (m_hasCaseSensitivityOverride)
+        m_keywordList->initLookupForCaseSensitivity(m_caseSensitivityOverride);
+    return true;
+}
+
+void KeywordListRule::doSave(QDataStream& stream) const
+{
+    stream << m_keywordList->name() << m_hasCaseSensitivityOverride << qint32(m_caseSensitivityOverride);
+}
+
+QString KeywordListRule::parameter() const
+{
+    return m_keywordList ? m_keywordList->name() : QString();
+}
+
 MatchResult KeywordListRule::doMatch(const QString& text, int offset, const QStringList&) const
 {
     auto newOffset = offset;
@@ -502,6 +783,20 @@ MatchResult KeywordListRule::doMatch(const QString& text, int offset, const QStr
     return MatchResult(offset, newOffset);
 }
 
+bool KeywordListRule::firstCharacters(std::bitset<128>& chars) const
+{
+    if (!m_keywordList)
+        return false;
+
+    const auto caseSensitivity = m_hasCaseSensitivityOverride ? m_caseSensitivityOverride
+                                                              : m_keywordList->caseSensitivity();
+    for (const auto& keyword : m_keywordList->keywords()) {
+        if (!keyword.isEmpty())
+            addFirstCharacter(chars, keyword.at(0), caseSensitivity);
+    }
+    return true;
+}
+
 bool LineContinue::doLoad(QXmlStreamReader& reader)
 {
     const auto s = reader.attributes().value(QStringLiteral("char"));
@@ -512,6 +807,17 @@ bool LineContinue::doLoad(QXmlStreamReader& reader)
     return true;
 }
 
+bool LineContinue::doLoad(QDataStream& stream)
+{
+    stream >> m_char;
+    return true;
+}
+
+void LineContinue::doSave(QDataStream& stream) const
+{
+    stream << m_char;
+}
+
 MatchResult LineContinue::doMatch(const QString& text, int offset, const QStringList&) const
 {
     if (offset == text.size() - 1 && text.at(offset) == m_char)
@@ -519,6 +825,12 @@ MatchResult LineContinue::doMatch(const QString& text, int offset, const QString
     return offset;
 }
 
+bool LineContinue::firstCharacters(std::bitset<128>& chars) const
+{
+    addFirstCharacter(chars, m_char, Qt::CaseSensitive);
+    return true;
+}
+
 bool RangeDetect::doLoad(QXmlStreamReader& reader)
 {
     const auto s1 = reader.attributes().value(QStringLiteral("char"));
@@ -530,6 +842,17 @@ bool RangeDetect::doLoad(QXmlStreamReader& reader)
     return true;
 }
 
+bool RangeDetect::doLoad(QDataStream& stream)
+{
+    stream >> m_begin >> m_end;
+    return true;
+}
+
+void RangeDetect::doSave(QDataStream& stream) const
+{
+    stream << m_begin << m_end;
+}
+
 MatchResult RangeDetect::doMatch(const QString& text, int offset, const QStringList&) const
 {
     if (text.size() - offset < 2)
@@ -546,26 +869,88 @@ MatchResult RangeDetect::doMatch(const QString& text, int offset, const QStringL
     return offset;
 }
 
+bool RangeDetect::firstCharacters(std::bitset<128>& chars) const
+{
+    addFirstCharacter(chars, m_begin, Qt::CaseSensitive);
+    return true;
+}
+
 bool RegExpr::doLoad(QXmlStreamReader& reader)
 {
-    m_regexp.setPattern(reader.attributes().value(QStringLiteral("String")).toString());
+    m_pattern = reader.attributes().value(QStringLiteral("String")).toString();
 
     const auto isMinimal = Xml::attrToBool(reader.attributes().value(QStringLiteral("minimal")));
     const auto isCaseInsensitive = Xml::attrToBool(reader.attributes().value(QStringLiteral("insensitive")));
-    m_regexp.setPatternOptions(
-        (isMinimal ? QRegularExpression::InvertedGreedinessOption : QRegularExpression::NoPatternOption) |
-        (isCaseInsensitive ? QRegularExpression::CaseInsensitiveOption : QRegularExpression::NoPatternOption));
+    m_options = (isMinimal ? QRegularExpression::InvertedGreedinessOption : QRegularExpression::NoPatternOption) |
+                (isCaseInsensitive ? QRegularExpression::CaseInsensitiveOption : QRegularExpression::NoPatternOption);
 
-    // optimize the pattern for the non-dynamic case, we use them OFTEN
+    // compile and optimize the pattern for the non-dynamic case, we use them OFTEN
     m_dynamic = Xml::attrToBool(reader.attributes().value(QStringLiteral("dynamic")));
     if (!m_dynamic) {
-        m_regexp.optimize();
+        m_regexp = RegexEngine::compile(m_pattern, m_options);
+
+        // always using m_regexp.isValid() would be better, but parses the regexp and thus is way too expensive for
+        // release builds
+        Q_ASSERT(m_regexp.isValid());
     }
 
-    // always using m_regexp.isValid() would be better, but parses the regexp and thus is way too expensive for release
-    // builds
-    Q_ASSERT(m_regexp.isValid());
-    return !m_regexp.pattern().isEmpty();
+    return !m_pattern.isEmpty();
+}
+
+bool RegExpr::doLoad(QDataStream& stream)
+{
+    qint32 options = 0;
+    stream >> m_pattern >> options >> m_dynamic;
+    m_options = static_cast<QRegularExpression::PatternOptions>(options);
+
+    if (!m_dynamic)
+        m_regexp = RegexEngine::compile(m_pattern, m_options);
+
+    return !m_pattern.isEmpty();
+}
+
+void RegExpr::doSave(QDataStream& stream) const
+{
+    stream << m_pattern << qint32(m_options) << m_dynamic;
+}
+
+QString RegExpr::parameter() const
+{
+    return m_pattern;
+}
+
+QRegularExpression RegExpr::dynamicRegExp(const QStringList& captures) const
+{
+    QMutexLocker lock(&m_cacheMutex);
+
+    const auto it = std::find_if(m_cache.begin(), m_cache.end(), [&captures](const CachedRegExp& entry) {
+        return entry.captures == captures;
+    });
+
+    if (it != m_cache.end()) {
+        std::rotate(m_cache.begin(), it, it + 1);
+        RegexEngine::recordDynamicCacheLookup(true);
+        return m_cache.front().regexp;
+    }
+
+    RegexEngine::recordDynamicCacheLookup(false);
+    const auto regexp = RegexEngine::compile(replaceCaptures(m_pattern, captures, true), m_options);
+
+    if (m_cache.size() >= DYNAMIC_CACHE_SIZE)
+        m_cache.pop_back();
+    m_cache.insert(m_cache.begin(), {captures, regexp});
+
+    return regexp;
+}
+
+namespace {
+// Rules are shared between the highlighting threads, so the flag is per thread.
+thread_local bool t_regexProfiling = false;
+} // namespace
+
+void RegExpr::setProfiling(bool enabled)
+{
+    t_regexProfiling = enabled;
 }
 
 MatchResult RegExpr::doMatch(const QString& text, int offset, const QStringList& captures) const
@@ -573,15 +958,13 @@ MatchResult RegExpr::doMatch(const QString& text, int offset, const QStringList&
     /**
      * for dynamic case: create new pattern with right instantiation
      */
-    const auto& regexp =
-        m_dynamic ? QRegularExpression(replaceCaptures(m_regexp.pattern(), captures, true), m_regexp.patternOptions())
-                  : m_regexp;
+    const auto& regexp = m_dynamic ? dynamicRegExp(captures) : m_regexp;
 
     /**
-     * match the pattern
+     * match the pattern, a pattern exceeding its backtracking limit counts as no match
      */
-    const auto result = regexp.match(
-        text, offset, QRegularExpression::NormalMatch, QRegularExpression::DontCheckSubjectStringMatchOption);
+    const auto result = RegexEngine::match(regexp, text, offset, QRegularExpression::DontCheckSubjectStringMatchOption,
+                                           nullptr, 0, t_regexProfiling);
     if (result.capturedStart() == offset) {
         /**
          * we only need to compute the captured texts if we have real capture groups
@@ -613,6 +996,24 @@ bool StringDetect::doLoad(QXmlStreamReader& reader)
     return !m_string.isEmpty();
 }
 
+bool StringDetect::doLoad(QDataStream& stream)
+{
+    qint32 caseSensitivity = Qt::CaseSensitive;
+    stream >> m_string >> caseSensitivity >> m_dynamic;
+    m_caseSensitivity = static_cast<Qt::CaseSensitivity>(caseSensitivity);
+    return !m_string.isEmpty();
+}
+
+void StringDetect::doSave(QDataStream& stream) const
+{
+    stream << m_string << qint32(m_caseSensitivity) << m_dynamic;
+}
+
+QString StringDetect::parameter() const
+{
+    return m_string;
+}
+
 MatchResult StringDetect::doMatch(const QString& text, int offset, const QStringList& captures) const
 {
     /**
@@ -625,6 +1026,14 @@ MatchResult StringDetect::doMatch(const QString& text, int offset, const QString
     return offset;
 }
 
+bool StringDetect::firstCharacters(std::bitset<128>& chars) const
+{
+    if (m_dynamic)
+        return false;
+    addFirstCharacter(chars, m_string.at(0), m_caseSensitivity);
+    return true;
+}
+
 bool WordDetect::doLoad(QXmlStreamReader& reader)
 {
     m_word = reader.attributes().value(QStringLiteral("String")).toString();
@@ -633,6 +1042,24 @@ bool WordDetect::doLoad(QXmlStreamReader& reader)
     return !m_word.isEmpty();
 }
 
+bool WordDetect::doLoad(QDataStream& stream)
+{
+    qint32 caseSensitivity = Qt::CaseSensitive;
+    stream >> m_word >> caseSensitivity;
+    m_caseSensitivity = static_cast<Qt::CaseSensitivity>(caseSensitivity);
+    return !m_word.isEmpty();
+}
+
+void WordDetect::doSave(QDataStream& stream) const
+{
+    stream << m_word << qint32(m_caseSensitivity);
+}
+
+QString WordDetect::parameter() const
+{
+    return m_word;
+}
+
 MatchResult WordDetect::doMatch(const QString& text, int offset, const QStringList&) const
 {
     if (text.size() - offset < m_word.size())
@@ -649,3 +1076,9 @@ MatchResult WordDetect::doMatch(const QString& text, int offset, const QStringLi
 
     return offset;
 }
+
+bool WordDetect::firstCharacters(std::bitset<128>& chars) const
+{
+    addFirstCharacter(chars, m_word.at(0), m_caseSensitivity);
+    return true;
+}
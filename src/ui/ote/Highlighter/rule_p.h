@@ -32,12 +32,16 @@
 #include "keywordlist_p.h"
 #include "matchresult_p.h"
 
+#include <QMutex>
 #include <QRegularExpression>
 #include <QString>
 #include <QVector>
 
+#include <bitset>
 #include <memory>
+#include <vector>
 
+class QDataStream;
 class QXmlStreamReader;
 
 namespace ote {
@@ -89,21 +93,61 @@ public:
     }
 
     bool load(QXmlStreamReader &reader);
+    bool load(QDataStream &stream);
+
+    /**
+     * Writes the rule as loaded from XML, i.e. before any resolving, to a definition cache.
+     * The rule type is written first, so that create(QDataStream&) can recreate it.
+     */
+    void save(QDataStream &stream) const;
+
     void resolveContext();
     void resolveAttributeFormat(Context *lookupContext);
 
     virtual MatchResult doMatch(const QString &text, int offset, const QStringList &captures) const = 0;
 
+    /**
+     * Characters (ASCII only) a match of this rule can start with, used to build the
+     * Context's dispatch table. Returns @c false if the rule might start with any character.
+     */
+    virtual bool firstCharacters(std::bitset<128> &chars) const;
+
+    /**
+     * A short human readable description of the rule for diagnostics, e.g. the highlighting
+     * profile: the element name in the XML file, followed by its main parameter and attribute.
+     */
+    QString description() const;
+
     static Rule::Ptr create(const QStringRef &name);
 
+    /**
+     * Reads a rule written by save(). Returns a null pointer if the rule was dropped
+     * when loading it from XML, or if @p stream is corrupt.
+     */
+    static Rule::Ptr create(QDataStream &stream);
+
 protected:
     virtual bool doLoad(QXmlStreamReader &reader);
+    virtual bool doLoad(QDataStream &stream);
+    virtual void doSave(QDataStream &stream) const;
+
+    /** The main parameter of the rule shown by description(), e.g. a regular expression. */
+    virtual QString parameter() const;
+
+    /**
+     * Adds @p c to @p chars, along with all ASCII characters matching it case-insensitively
+     * if @p caseSensitivity is Qt::CaseInsensitive.
+     */
+    static void addFirstCharacter(std::bitset<128> &chars, QChar c, Qt::CaseSensitivity caseSensitivity);
 
     bool isWordDelimiter(QChar c) const;
 
 private:
     Q_DISABLE_COPY(Rule)
 
+    static Rule::Ptr create(int type);
+
+    int m_type = -1; // index into the table of rule types in rule.cpp
     DefinitionRef m_def;
     QString m_attribute;
     Format m_attributeFormat;
@@ -122,7 +166,11 @@ private:
 class AnyChar : public Rule
 {
 protected:
+    bool firstCharacters(std::bitset<128> &chars) const override;
     bool doLoad(QXmlStreamReader & reader) override;
+    bool doLoad(QDataStream &stream) override;
+    void doSave(QDataStream &stream) const override;
+    QString parameter() const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList&) const override;
 
 private:
@@ -132,7 +180,11 @@ private:
 class DetectChar : public Rule
 {
 protected:
+    bool firstCharacters(std::bitset<128> &chars) const override;
     bool doLoad(QXmlStreamReader & reader) override;
+    bool doLoad(QDataStream &stream) override;
+    void doSave(QDataStream &stream) const override;
+    QString parameter() const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList &captures) const override;
 
 private:
@@ -144,7 +196,11 @@ private:
 class Detect2Char : public Rule
 {
 protected:
+    bool firstCharacters(std::bitset<128> &chars) const override;
     bool doLoad(QXmlStreamReader & reader) override;
+    bool doLoad(QDataStream &stream) override;
+    void doSave(QDataStream &stream) const override;
+    QString parameter() const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList &captures) const override;
 
 private:
@@ -155,18 +211,21 @@ private:
 class DetectIdentifier : public Rule
 {
 protected:
+    bool firstCharacters(std::bitset<128> &chars) const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList&) const override;
 };
 
 class DetectSpaces : public Rule
 {
 protected:
+    bool firstCharacters(std::bitset<128> &chars) const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList&) const override;
 };
 
 class Float : public Rule
 {
 protected:
+    bool firstCharacters(std::bitset<128> &chars) const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList&) const override;
 };
 
@@ -179,6 +238,9 @@ public:
 
 protected:
     bool doLoad(QXmlStreamReader & reader) override;
+    bool doLoad(QDataStream &stream) override;
+    void doSave(QDataStream &stream) const override;
+    QString parameter() const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList&) const override;
 
 private:
@@ -190,37 +252,46 @@ private:
 class Int : public Rule
 {
 protected:
+    bool firstCharacters(std::bitset<128> &chars) const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList &captures) const override;
 };
 
 class HlCChar : public Rule
 {
 protected:
+    bool firstCharacters(std::bitset<128> &chars) const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList&) const override;
 };
 
 class HlCHex : public Rule
 {
 protected:
+    bool firstCharacters(std::bitset<128> &chars) const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList&) const override;
 };
 
 class HlCOct : public Rule
 {
 protected:
+    bool firstCharacters(std::bitset<128> &chars) const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList&) const override;
 };
 
 class HlCStringChar : public Rule
 {
 protected:
+    bool firstCharacters(std::bitset<128> &chars) const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList&) const override;
 };
 
 class KeywordListRule : public Rule
 {
 protected:
+    bool firstCharacters(std::bitset<128> &chars) const override;
     bool doLoad(QXmlStreamReader & reader) override;
+    bool doLoad(QDataStream &stream) override;
+    void doSave(QDataStream &stream) const override;
+    QString parameter() const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList&) const override;
 
 private:
@@ -232,7 +303,10 @@ private:
 class LineContinue : public Rule
 {
 protected:
+    bool firstCharacters(std::bitset<128> &chars) const override;
     bool doLoad(QXmlStreamReader & reader) override;
+    bool doLoad(QDataStream &stream) override;
+    void doSave(QDataStream &stream) const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList&) const override;
 
 private:
@@ -242,7 +316,10 @@ private:
 class RangeDetect : public Rule
 {
 protected:
+    bool firstCharacters(std::bitset<128> &chars) const override;
     bool doLoad(QXmlStreamReader & reader) override;
+    bool doLoad(QDataStream &stream) override;
+    void doSave(QDataStream &stream) const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList&) const override;
 
 private:
@@ -252,19 +329,50 @@ private:
 
 class RegExpr : public Rule
 {
+public:
+    /**
+     * Sets whether the matches of this thread are recorded by RegexEngine's profiler, so that it isn't
+     * looked up for every match. AbstractHighlighter sets it before each line.
+     */
+    static void setProfiling(bool enabled);
+
 protected:
     bool doLoad(QXmlStreamReader & reader) override;
+    bool doLoad(QDataStream &stream) override;
+    void doSave(QDataStream &stream) const override;
+    QString parameter() const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList &captures) const override;
 
 private:
-    QRegularExpression m_regexp;
+    /**
+     * Returns the pattern instantiated with @p captures, compiled. The last few instantiations
+     * are cached, since e.g. a heredoc's terminator is looked for on every line until it's found.
+     */
+    QRegularExpression dynamicRegExp(const QStringList &captures) const;
+
+    QString m_pattern;
+    QRegularExpression::PatternOptions m_options;
+    QRegularExpression m_regexp; // only compiled if !m_dynamic
     bool m_dynamic = false;
+
+    struct CachedRegExp {
+        QStringList captures;
+        QRegularExpression regexp;
+    };
+
+    // LRU cache for dynamic patterns, most recently used first. Rules are shared between threads.
+    mutable QMutex m_cacheMutex;
+    mutable std::vector<CachedRegExp> m_cache;
 };
 
 class StringDetect : public Rule
 {
 protected:
+    bool firstCharacters(std::bitset<128> &chars) const override;
     bool doLoad(QXmlStreamReader & reader) override;
+    bool doLoad(QDataStream &stream) override;
+    void doSave(QDataStream &stream) const override;
+    QString parameter() const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList &captures) const override;
 
 private:
@@ -276,7 +384,11 @@ private:
 class WordDetect : public Rule
 {
 protected:
+    bool firstCharacters(std::bitset<128> &chars) const override;
     bool doLoad(QXmlStreamReader & reader) override;
+    bool doLoad(QDataStream &stream) override;
+    void doSave(QDataStream &stream) const override;
+    QString parameter() const override;
     MatchResult doMatch(const QString & text, int offset, const QStringList &captures) const override;
 
 private:
@@ -27,76 +27,191 @@
 #include "context_p.h"
 #include "state_p.h"
 
-#include <QStringList>
+#include <QMultiHash>
+#include <QMutex>
+
+namespace ote {
+
+/**
+ * The intern table holding every StateData node that is currently in use.
+ * States are created both on the GUI thread and by highlight workers, so access is serialized.
+ * Only creating nodes and dropping their last reference need the lock.
+ */
+class StateTable
+{
+public:
+    const StateData* intern(const StateData *parent, Context *context, const QStringList &captures,
+                            const DefinitionRef &defRef);
+    void remove(const StateData *node);
+
+    QMutex mutex;
+
+private:
+    QMultiHash<uint, const StateData*> m_nodes;
+};
+
+}
 
 using namespace ote;
 
-StateData* StateData::get(State& state)
+namespace {
+
+Q_GLOBAL_STATIC(StateTable, s_table)
+
+}
+
+const StateData* StateTable::intern(const StateData *parent, Context *context, const QStringList &captures,
+                                    const DefinitionRef &defRef)
 {
-    state.d.detach();
-    return state.d.data();
+    uint hash = qHash(quintptr(parent));
+    hash = hash * 31 + qHash(quintptr(context));
+    hash = hash * 31 + qHash(captures);
+
+    QMutexLocker lock(&mutex);
+    for (auto it = m_nodes.constFind(hash); it != m_nodes.constEnd() && it.key() == hash; ++it) {
+        const StateData *node = it.value();
+        if (node->m_parent == parent && node->m_context == context && node->m_captures == captures &&
+                node->m_defRef == defRef) {
+            node->m_ref.ref();
+            return node;
+        }
+    }
+
+    const auto node = new StateData(parent, context, captures, defRef, hash);
+    m_nodes.insert(hash, node);
+    return node;
 }
 
-bool StateData::isEmpty() const
+void StateTable::remove(const StateData *node)
 {
-    return m_contextStack.isEmpty();
+    auto it = m_nodes.find(node->m_hash);
+    while (it != m_nodes.end() && it.key() == node->m_hash) {
+        if (it.value() == node) {
+            m_nodes.erase(it);
+            return;
+        }
+        ++it;
+    }
 }
 
-void StateData::clear()
+StateData::StateData(const StateData *parent, Context *context, const QStringList &captures,
+                     const DefinitionRef &defRef, uint hash)
+    : m_parent(parent)
+    , m_context(context)
+    , m_captures(captures)
+    , m_defRef(defRef)
+    , m_size(parent ? parent->m_size + 1 : 1)
+    , m_hash(hash)
+    , m_ref(1)
 {
-    m_contextStack.clear();
+    acquire(parent);
 }
 
-int StateData::size() const
+void StateData::acquire(const StateData *node)
 {
-    return m_contextStack.size();
+    if (node)
+        node->m_ref.ref();
 }
 
-void StateData::push(Context* context, const QStringList& captures)
+void StateData::release(const StateData *node)
 {
-    Q_ASSERT(context);
-    m_contextStack.push_back(qMakePair(context, captures));
+    while (node) {
+        // Not the last reference: no need to lock, nobody can drop the count to zero concurrently
+        // without also holding a reference.
+        int ref = node->m_ref.loadAcquire();
+        while (ref > 1) {
+            if (node->m_ref.testAndSetOrdered(ref, ref - 1))
+                return;
+            ref = node->m_ref.loadAcquire();
+        }
+
+        // Possibly the last reference. intern() may hand out the node again until it's removed
+        // from the table, so decide under the lock.
+        const StateData *parent = node->m_parent;
+        if (s_table.isDestroyed()) {
+            if (node->m_ref.deref())
+                return;
+        } else {
+            StateTable *table = s_table();
+            QMutexLocker lock(&table->mutex);
+            if (node->m_ref.deref())
+                return;
+            table->remove(node);
+        }
+
+        delete node;
+        node = parent; // The node's reference to its parent
+    }
+}
+
+const StateData* StateData::get(const State& state)
+{
+    return state.d;
 }
 
-void StateData::pop()
+void StateData::push(State& state, Context* context, const QStringList& captures, const DefinitionRef& defRef)
 {
-    m_contextStack.pop_back();
+    Q_ASSERT(context);
+    const StateData *node = s_table()->intern(state.d, context, captures, defRef);
+    release(state.d);
+    state.d = node;
 }
 
-Context* StateData::topContext() const
+void StateData::pop(State& state)
 {
-    Q_ASSERT(!isEmpty());
-    return m_contextStack.last().first;
+    Q_ASSERT(state.d);
+    const StateData *node = state.d;
+    state.d = node->m_parent;
+    acquire(state.d);
+    release(node);
 }
 
-const QStringList& StateData::topCaptures() const
+void StateData::clear(State& state)
 {
-    Q_ASSERT(!isEmpty());
-    return m_contextStack.last().second;
+    release(state.d);
+    state.d = nullptr;
 }
 
 State::State()
-    : d(new StateData)
+    : d(nullptr)
 {
 }
 
 State::State(const State& other)
     : d(other.d)
 {
+    StateData::acquire(d);
 }
 
-State::~State() {}
+State::State(State&& other) noexcept
+    : d(other.d)
+{
+    other.d = nullptr;
+}
+
+State::~State()
+{
+    StateData::release(d);
+}
 
 State& State::operator=(const State& other)
 {
+    StateData::acquire(other.d);
+    StateData::release(d);
     d = other.d;
     return *this;
 }
 
+State& State::operator=(State&& other) noexcept
+{
+    std::swap(d, other.d);
+    return *this;
+}
+
 bool State::operator==(const State& other) const
 {
-    // use pointer equal as shortcut for shared states
-    return (d == other.d) || (d->m_contextStack == other.d->m_contextStack && d->m_defRef == other.d->m_defRef);
+    // states are interned, equal context stacks share the same node
+    return d == other.d;
 }
 
 bool State::operator!=(const State& other) const
@@ -106,7 +221,7 @@ bool State::operator!=(const State& other) const
 
 bool State::indentationBasedFoldingEnabled() const
 {
-    if (d->m_contextStack.isEmpty())
+    if (!d)
         return false;
-    return d->m_contextStack.last().first->indentationBasedFoldingEnabled();
+    return d->m_context->indentationBasedFoldingEnabled();
 }
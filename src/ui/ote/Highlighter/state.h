@@ -26,7 +26,6 @@
 
 
 
-#include <QExplicitlySharedDataPointer>
 #include <QTypeInfo>
 
 namespace ote {
@@ -48,13 +47,16 @@ public:
      */
     State();
     State(const State &other);
+    State(State &&other) noexcept;
     ~State();
     State& operator=(const State &rhs);
+    State& operator=(State &&rhs) noexcept;
 
     /** Compares two states for equality.
      *  For two equal states and identical text input, AbstractHighlighter
      *  guarantees to produce equal results. This can be used to only
      *  re-highlight as many lines as necessary during editing.
+     *  States are interned, so this is a pointer comparison.
      */
     bool operator==(const State &other) const;
     /** Compares two states for inequality.
@@ -74,7 +76,7 @@ public:
 
 private:
     friend class StateData;
-    QExplicitlySharedDataPointer<StateData> d;
+    const StateData *d;
 };
 
 }
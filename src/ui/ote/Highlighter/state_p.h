@@ -25,47 +25,68 @@
 #ifndef KSYNTAXHIGHLIGHTING_STATE_P_H
 #define KSYNTAXHIGHLIGHTING_STATE_P_H
 
-#include <QSharedData>
-#include <QVector>
+#include <QAtomicInt>
+#include <QStringList>
 
 #include "definitionref_p.h"
 
-QT_BEGIN_NAMESPACE
-class QStringList;
-QT_END_NAMESPACE
-
 namespace ote
 {
 
 class Context;
-
-class StateData : public QSharedData
+class State;
+
+/**
+ * A single entry of a context stack.
+ *
+ * Nodes are immutable and hash-consed: each distinct (parent, context, captures, definition)
+ * combination exists at most once, so equal stacks share one node, stacks that only differ
+ * at the top share their tail, and two states are equal iff they point to the same node.
+ * Nodes are reference counted and removed from the intern table once unused.
+ */
+class StateData
 {
     friend class State;
-    friend class AbstractHighlighter;
 
 public:
-    StateData() = default;
-    static StateData* get(State &state);
+    /** Returns the top of @p state's context stack, or nullptr if the stack is empty. */
+    static const StateData* get(const State &state);
+
+    /** Pushes @p context with @p captures onto @p state's context stack. */
+    static void push(State &state, Context *context, const QStringList &captures, const DefinitionRef &defRef);
+    static void pop(State &state);
+    static void clear(State &state);
 
-    bool isEmpty() const;
-    void clear();
-    int size() const;
-    void push(Context *context, const QStringList &captures);
-    void pop();
-    Context* topContext() const;
-    const QStringList &topCaptures() const;
+    int size() const { return m_size; }
+    Context* context() const { return m_context; }
+    const QStringList &captures() const { return m_captures; }
+    const DefinitionRef &definitionRef() const { return m_defRef; }
 
 private:
+    friend class StateTable;
+
+    StateData(const StateData *parent, Context *context, const QStringList &captures,
+              const DefinitionRef &defRef, uint hash);
+    ~StateData() = default;
+
+    static void acquire(const StateData *node);
+    static void release(const StateData *node);
+
     /**
-     * weak reference to the used definition to filter out invalid states
+     * the rest of the context stack, owns a reference
      */
-    DefinitionRef m_defRef;
+    const StateData *m_parent;
+    Context *m_context;
+    QStringList m_captures;
 
     /**
-     * the context stack combines the active context + valid captures
+     * weak reference to the used definition to filter out invalid states
      */
-    QVector<QPair<Context *, QStringList>> m_contextStack;
+    DefinitionRef m_defRef;
+
+    int m_size;
+    uint m_hash;
+    mutable QAtomicInt m_ref;
 };
 
 }
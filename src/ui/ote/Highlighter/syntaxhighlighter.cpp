@@ -24,16 +24,25 @@
 #include "syntaxhighlighter.h"
 
 #include "abstracthighlighter_p.h"
+#include "blockdata_p.h"
 #include "definition.h"
 #include "format.h"
 #include "theme.h"
 #include "state.h"
 #include "fmtrangelist.h"
+#include "foldingindex_p.h"
 #include "foldingregion.h"
+#include "highlightworker_p.h"
 #include "../util/scopeguard.h"
 
 #include <QDebug>
 #include <QTextDocument>
+#include <QTimer>
+
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
 
 Q_DECLARE_METATYPE(QTextBlock)
 
@@ -41,27 +50,125 @@ using namespace ote;
 
 namespace ote {
 
-class TextBlockUserData : public QTextBlockUserData {
-public:
-    State state;
-    QVector<FoldingRegion> foldingRegions;
-    FmtRangeList fmtList;
-    bool bookmarked = false;
-    bool forceRehighlighting = false;
-
-    std::map<int, std::unique_ptr<PluginBlockData>> extraData;
-};
-
 class SyntaxHighlighterPrivate : public AbstractHighlighterPrivate {
 public:
     static FoldingRegion foldingRegion(const QTextBlock& startBlock);
-    QVector<FoldingRegion> foldingRegions;
-    FmtRangeList fmtList;
+    static TextBlockUserData* userData(const QTextBlock& block);
+    static State blockState(const QTextBlock& block);
+    static bool hasState(const QTextBlock& block);
+    static bool isHighlighted(const QTextBlock& block);
+
+    /**
+     * Returns the first block from @p block up to block number @p last (-1 for the end of the document)
+     * that isn't highlighted, or an invalid block.
+     */
+    static QTextBlock firstUnhighlighted(QTextBlock block, int last);
+
+    void markUnhighlighted(const QTextBlock& block, bool keepState);
+
+    struct CharFormat {
+        QTextCharFormat format;
+        Format source;          // Kept to convert the format again when the theme changes
+        bool isDefault = true;  // Whether the theme's default text style applies, i.e. nothing needs to be set
+        bool valid = false;
+    };
+
+    /**
+     * Precomputes the QTextCharFormats of the current definition, and of all definitions it
+     * includes, for the current theme.
+     */
+    void buildCharFormats();
+
+    /**
+     * Returns the QTextCharFormat of @p format for the current theme. Formats not known to
+     * buildCharFormats() are converted on first use.
+     */
+    const CharFormat& charFormat(const Format& format);
+
+    /**
+     * Converts all known formats again for the current theme, keeping their ids.
+     */
+    void updateCharFormats();
+
+    /**
+     * Returns the blocks shown in each view, or the start of the document before any view reported them.
+     */
+    std::vector<std::pair<int, int>> visibleRanges() const;
+
+    std::vector<CharFormat> charFormats; // Indexed by Format::id()
+
+    mutable FoldingIndex foldingIndex;
+
+    HighlightedBlock* current = nullptr; // Receives applyFormat()/applyFolding() calls
+
+    HighlightWorker* worker = nullptr;
+    std::shared_ptr<std::atomic<int>> generation = std::make_shared<std::atomic<int>>(0);
+
+    // Background highlighting, in order of priority:
+    std::set<int> pendingBlocks; // Highlighted blocks following an edit that changed their start state
+    std::map<const QObject*, std::pair<int, int>> visibleBlocks; // First and last block shown in each view
+    int fillFrom = -1;           // All blocks before this one are highlighted. -1 if the whole document is.
+
+    int checkpoint = -1;         // Last block whose state was computed by a states-only job
+    bool jobRunning = false;
+    bool jobFromPending = false;
+    int jobFirstBlock = 0;
+    int jobLastBlock = 0;
+    int blockCount = 0;          // The document's block count, to tell how far block numbers moved after a change
+    bool dispatchQueued = false;
+    bool applyingResults = false;
+    int syncBlocks = 0;          // Number of blocks highlighted on the GUI thread in this event loop iteration
+    bool reapplying = false;     // highlightBlock() only reapplies the block's stored format runs
+    int reapplyFrom = -1;        // First block whose format runs weren't reapplied since the theme changed
+
+    int maxLineLength;           // Line budget, see setLineBudget()
+    qint64 maxLineNsecs;
 };
 
+namespace {
+
+// Edits are highlighted right away for up to this many blocks per event loop iteration. Any further
+// blocks, e.g. when pasting lots of text, are left to the background worker.
+const int MAX_SYNC_BLOCKS = 256;
+
+// Number of blocks highlighted by the worker in one go. Each job's results are applied at once.
+const int JOB_SIZE = 512;
+
+// Number of blocks per job when only computing states. These jobs don't touch the document's formats.
+const int STATES_JOB_SIZE = 4096;
+
+// Number of blocks whose formats are reapplied per event loop iteration after a theme change
+const int REAPPLY_BATCH_SIZE = 2000;
+
+// Default line budget: longer lines are highlighted in parts, see SyntaxHighlighter::setLineBudget()
+const int DEFAULT_MAX_LINE_LENGTH = 50000;
+const int DEFAULT_MAX_LINE_MSECS = 20;
+
+QTextCharFormat toTextCharFormat(const Format& format, const Theme& theme)
+{
+    QTextCharFormat tf;
+    if (format.hasTextColor(theme))
+        tf.setForeground(format.textColor(theme));
+    if (format.hasBackgroundColor(theme))
+        tf.setBackground(format.backgroundColor(theme));
+
+    if (format.isBold(theme))
+        tf.setFontWeight(QFont::Bold);
+    if (format.isItalic(theme))
+        tf.setFontItalic(true);
+    if (format.isUnderline(theme))
+        tf.setFontUnderline(true);
+    if (format.isStrikeThrough(theme))
+        tf.setFontStrikeOut(true);
+
+    return tf;
+}
+
+} // namespace
+
 FoldingRegion SyntaxHighlighterPrivate::foldingRegion(const QTextBlock& startBlock)
 {
-    const auto data = dynamic_cast<TextBlockUserData*>(startBlock.userData());
+    const auto data = TextBlockUserData::get(startBlock);
     if (!data)
         return FoldingRegion();
     for (int i = data->foldingRegions.size() - 1; i >= 0; --i) {
@@ -71,30 +178,212 @@ FoldingRegion SyntaxHighlighterPrivate::foldingRegion(const QTextBlock& startBlo
     return FoldingRegion();
 }
 
-unsigned int SyntaxHighlighter::s_continuousIterations = 0;
+TextBlockUserData* SyntaxHighlighterPrivate::userData(const QTextBlock& block)
+{
+    return TextBlockUserData::get(block);
+}
+
+State SyntaxHighlighterPrivate::blockState(const QTextBlock& block)
+{
+    const auto data = userData(block);
+    return data && data->hasState ? data->state : State();
+}
+
+bool SyntaxHighlighterPrivate::hasState(const QTextBlock& block)
+{
+    const auto data = userData(block);
+    return data && data->hasState;
+}
+
+bool SyntaxHighlighterPrivate::isHighlighted(const QTextBlock& block)
+{
+    const auto data = userData(block);
+    return data && data->highlighted;
+}
+
+QTextBlock SyntaxHighlighterPrivate::firstUnhighlighted(QTextBlock block, int last)
+{
+    while (block.isValid() && (last < 0 || block.blockNumber() <= last)) {
+        if (!isHighlighted(block))
+            return block;
+        block = block.next();
+    }
+    return QTextBlock();
+}
+
+void SyntaxHighlighterPrivate::buildCharFormats()
+{
+    charFormats.clear();
+
+    QVector<Format> formats = m_definition.formats();
+    for (const auto& def : m_definition.includedDefinitions())
+        formats += def.formats();
+
+    for (const auto& format : formats)
+        charFormat(format);
+}
+
+const SyntaxHighlighterPrivate::CharFormat& SyntaxHighlighterPrivate::charFormat(const Format& format)
+{
+    const auto id = format.id();
+    if (id >= charFormats.size())
+        charFormats.resize(id + 1);
+
+    auto& entry = charFormats[id];
+    if (!entry.valid) {
+        entry.source = format;
+        entry.isDefault = format.isDefaultTextStyle(m_theme);
+        if (!entry.isDefault)
+            entry.format = toTextCharFormat(format, m_theme);
+        entry.valid = true;
+    }
+    return entry;
+}
+
+void SyntaxHighlighterPrivate::updateCharFormats()
+{
+    for (auto& entry : charFormats) {
+        if (!entry.valid)
+            continue;
+        entry.isDefault = entry.source.isDefaultTextStyle(m_theme);
+        entry.format = entry.isDefault ? QTextCharFormat() : toTextCharFormat(entry.source, m_theme);
+    }
+}
+
+std::vector<std::pair<int, int>> SyntaxHighlighterPrivate::visibleRanges() const
+{
+    if (visibleBlocks.empty())
+        return {{0, 100}};
+
+    std::vector<std::pair<int, int>> ranges;
+    ranges.reserve(visibleBlocks.size());
+    for (const auto& entry : visibleBlocks)
+        ranges.push_back(entry.second);
+    return ranges;
+}
+
+void SyntaxHighlighterPrivate::markUnhighlighted(const QTextBlock& block, bool keepState)
+{
+    const int number = block.blockNumber();
+    if (fillFrom < 0 || number < fillFrom)
+        fillFrom = number;
+
+    if (auto data = userData(block)) {
+        data->highlighted = false;
+        data->hasState = data->hasState && keepState;
+    }
+}
 
 SyntaxHighlighter::SyntaxHighlighter(QObject* parent)
     : QSyntaxHighlighter(parent)
     , AbstractHighlighter(new SyntaxHighlighterPrivate)
 {
-    qRegisterMetaType<QTextBlock>();
+    initWorker();
 }
 
 SyntaxHighlighter::SyntaxHighlighter(QTextDocument* document)
-    : QSyntaxHighlighter(document)
+    : QSyntaxHighlighter(static_cast<QObject*>(document))
     , AbstractHighlighter(new SyntaxHighlighterPrivate)
 {
-    qRegisterMetaType<QTextBlock>();
+    initWorker();
+    setDocument(document);
 }
 
-SyntaxHighlighter::~SyntaxHighlighter() {}
+SyntaxHighlighter::~SyntaxHighlighter()
+{
+    Q_D(SyntaxHighlighter);
+    cancelJob();
+    d->worker->deleteLater();
+}
+
+void SyntaxHighlighter::setDocument(QTextDocument* doc)
+{
+    Q_D(SyntaxHighlighter);
+
+    if (document())
+        disconnect(document(), &QTextDocument::contentsChange, this, &SyntaxHighlighter::onContentsChange);
+
+    // Connected before QSyntaxHighlighter connects its own handler, so it runs first.
+    if (doc) {
+        connect(doc, &QTextDocument::contentsChange, this, &SyntaxHighlighter::onContentsChange);
+        d->blockCount = doc->blockCount();
+    }
+    d->foldingIndex.invalidateFrom(0);
+
+    QSyntaxHighlighter::setDocument(doc);
+}
+
+void SyntaxHighlighter::onContentsChange(int position, int removed, int added)
+{
+    Q_UNUSED(removed);
+    Q_D(SyntaxHighlighter);
+
+    const int blockCount = document()->blockCount();
+    const int delta = blockCount - d->blockCount;
+    d->blockCount = blockCount;
+
+    // Paragraph separators were added or removed: the folding regions after the changed block have
+    // moved, even if as many separators were added as removed.
+    const int changed = document()->findBlock(position).blockNumber();
+    if (delta != 0 || document()->findBlock(position + added).blockNumber() != changed)
+        d->foldingIndex.invalidateFrom(changed);
+
+    if (delta == 0)
+        return;
+
+    // The blocks after the changed one moved by 'delta'. Numbers of removed blocks map to
+    // 'removedTo': the changed block, which is rehighlighted anyway, or -1 for none.
+    const auto shift = [changed, delta](int number, int removedTo) {
+        if (number <= changed)
+            return number;
+        return number + delta > changed ? number + delta : removedTo;
+    };
+
+    std::set<int> pending;
+    for (const int number : d->pendingBlocks)
+        pending.insert(shift(number, changed));
+    d->pendingBlocks.swap(pending);
+
+    d->checkpoint = shift(d->checkpoint, -1);
+    if (d->fillFrom >= 0)
+        d->fillFrom = shift(d->fillFrom, changed);
+    if (d->reapplyFrom >= 0)
+        d->reapplyFrom = shift(d->reapplyFrom, changed);
+
+    // A running job covering the moved blocks would apply its results to the wrong ones.
+    if (d->jobRunning && changed <= d->jobLastBlock) {
+        if (d->jobFromPending)
+            d->pendingBlocks.insert(shift(d->jobFirstBlock, changed));
+        cancelJob();
+        queueDispatch();
+    }
+}
+
+void SyntaxHighlighter::initWorker()
+{
+    Q_D(SyntaxHighlighter);
+    qRegisterMetaType<QTextBlock>();
+    qRegisterMetaType<QSharedPointer<ote::HighlightJob>>();
+
+    d->maxLineLength = DEFAULT_MAX_LINE_LENGTH;
+    d->maxLineNsecs = DEFAULT_MAX_LINE_MSECS * qint64(1000000);
+
+    d->worker = new HighlightWorker(d->generation);
+    connect(d->worker, &HighlightWorker::finished, this, &SyntaxHighlighter::applyResults);
+}
 
 void SyntaxHighlighter::setEnabled(bool enabled)
 {
     if (m_enabled == enabled) return;
 
     m_enabled = enabled;
-    if (m_enabled) startRehighlighting();
+    if (m_enabled) {
+        startRehighlighting();
+    } else {
+        Q_D(SyntaxHighlighter);
+        cancelJob();
+        d->pendingBlocks.clear();
+    }
 }
 
 void SyntaxHighlighter::setDefinition(const Definition& def)
@@ -102,55 +391,120 @@ void SyntaxHighlighter::setDefinition(const Definition& def)
     if (definition() == def)
         return;
 
+    Q_D(SyntaxHighlighter);
     AbstractHighlighter::setDefinition(def);
-    startRehighlighting();
+    d->buildCharFormats();
+    invalidate(false); // States of the old definition are useless
 }
 
-bool SyntaxHighlighter::startsFoldingRegion(const QTextBlock& startBlock) const
+void SyntaxHighlighter::setTheme(const Theme& theme)
 {
-    return SyntaxHighlighterPrivate::foldingRegion(startBlock).type() == FoldingRegion::Begin;
+    Q_D(SyntaxHighlighter);
+    AbstractHighlighter::setTheme(theme);
+    d->updateCharFormats();
+
+    if (!document())
+        return;
+
+    // The blocks' format runs are still valid, only their colors change. Convert the visible
+    // blocks right away, the rest of the document in batches.
+    for (const auto& range : d->visibleRanges())
+        reapplyFormats(document()->findBlockByNumber(range.first), range.second, range.second - range.first + 1);
+
+    const bool batchRunning = d->reapplyFrom >= 0;
+    d->reapplyFrom = 0;
+    if (!batchRunning)
+        QTimer::singleShot(0, this, &SyntaxHighlighter::reapplyFormatsBatch);
 }
 
-QTextBlock SyntaxHighlighter::findFoldingRegionBegin(const QTextBlock& startBlock) const {
-    if (startsFoldingRegion(startBlock))
-        return startBlock;
+QTextBlock SyntaxHighlighter::reapplyFormats(QTextBlock block, int last, int maxBlocks)
+{
+    Q_D(SyntaxHighlighter);
 
-    auto block = startBlock.previous();
-    while(block.isValid() && !startsFoldingRegion(block))
-        block = block.previous();
+    d->reapplying = true;
+    for (int i = 0; i < maxBlocks && block.isValid() && (last < 0 || block.blockNumber() <= last);
+         ++i, block = block.next()) {
+        if (SyntaxHighlighterPrivate::isHighlighted(block))
+            rehighlightBlock(block);
+    }
+    d->reapplying = false;
 
     return block;
 }
 
-QTextBlock SyntaxHighlighter::findFoldingRegionEnd(const QTextBlock& startBlock) const
+void SyntaxHighlighter::reapplyFormatsBatch()
 {
-    const auto region = SyntaxHighlighterPrivate::foldingRegion(startBlock);
+    Q_D(SyntaxHighlighter);
 
-    auto block = startBlock;
-    int depth = 1;
-    while (block.isValid()) {
-        block = block.next();
-        const auto data = dynamic_cast<TextBlockUserData*>(block.userData());
-        if (!data)
-            continue;
-        for (auto it = data->foldingRegions.constBegin(); it != data->foldingRegions.constEnd(); ++it) {
-            if ((*it).id() != region.id())
-                continue;
-            if ((*it).type() == FoldingRegion::End)
-                --depth;
-            else if ((*it).type() == FoldingRegion::Begin)
-                ++depth;
-            if (depth == 0)
-                return block;
-        }
+    if (d->reapplyFrom < 0 || !document())
+        return;
+
+    // Reapplying the visible blocks again is cheap: QSyntaxHighlighter skips unchanged formats.
+    const QTextBlock next = reapplyFormats(document()->findBlockByNumber(d->reapplyFrom), -1, REAPPLY_BATCH_SIZE);
+    if (!next.isValid()) {
+        d->reapplyFrom = -1;
+        return;
     }
 
-    return QTextBlock();
+    d->reapplyFrom = next.blockNumber();
+    QTimer::singleShot(0, this, &SyntaxHighlighter::reapplyFormatsBatch);
+}
+
+void SyntaxHighlighter::setVisibleBlocks(const QObject* view, int first, int last)
+{
+    Q_D(SyntaxHighlighter);
+
+    const auto range = std::make_pair(first, last);
+    auto it = d->visibleBlocks.find(view);
+    if (it != d->visibleBlocks.end() && it->second == range)
+        return;
+
+    d->visibleBlocks[view] = range;
+
+    if (!document() || !SyntaxHighlighterPrivate::firstUnhighlighted(document()->findBlockByNumber(first), last).isValid())
+        return;
+
+    // Unhighlighted blocks scrolled into view. Don't let a job elsewhere in the document hold them up.
+    if (d->jobRunning && !d->jobFromPending)
+        cancelJob();
+    queueDispatch();
+}
+
+void SyntaxHighlighter::removeVisibleBlocks(const QObject* view)
+{
+    Q_D(SyntaxHighlighter);
+    d->visibleBlocks.erase(view);
+}
+
+void SyntaxHighlighter::setLineBudget(int maxLength, int maxMsecs)
+{
+    Q_D(SyntaxHighlighter);
+    d->maxLineLength = maxLength > 0 ? maxLength : -1;
+    d->maxLineNsecs = maxMsecs > 0 ? maxMsecs * qint64(1000000) : -1;
+}
+
+bool SyntaxHighlighter::startsFoldingRegion(const QTextBlock& startBlock) const
+{
+    return SyntaxHighlighterPrivate::foldingRegion(startBlock).type() == FoldingRegion::Begin;
+}
+
+QTextBlock SyntaxHighlighter::findFoldingRegionBegin(const QTextBlock& startBlock) const
+{
+    Q_D(const SyntaxHighlighter);
+    const int begin = d->foldingIndex.regionBegin(document(), startBlock.blockNumber());
+    return begin < 0 ? QTextBlock() : document()->findBlockByNumber(begin);
+}
+
+QTextBlock SyntaxHighlighter::findFoldingRegionEnd(const QTextBlock& startBlock) const
+{
+    Q_D(const SyntaxHighlighter);
+    const int end = d->foldingIndex.regionEnd(document(), startBlock.blockNumber());
+    return end < 0 ? QTextBlock() : document()->findBlockByNumber(end);
 }
 
 bool SyntaxHighlighter::isBookmarked(const QTextBlock& block) const
 {
-    auto data = dynamic_cast<TextBlockUserData*>(block.userData());
+    auto data = TextBlockUserData::get(block);
     if (!data)
         return false;
 
@@ -159,7 +513,7 @@ bool SyntaxHighlighter::isBookmarked(const QTextBlock& block) const
 
 void SyntaxHighlighter::setBookmark(QTextBlock block, bool bookmarked)
 {
-    auto data = dynamic_cast<TextBlockUserData*>(block.userData());
+    auto data = TextBlockUserData::get(block);
     if (!data) {
         data = new TextBlockUserData();
         block.setUserData(data);
@@ -169,7 +523,7 @@ void SyntaxHighlighter::setBookmark(QTextBlock block, bool bookmarked)
 
 void SyntaxHighlighter::toggleBookmark(QTextBlock block)
 {
-    auto data = dynamic_cast<TextBlockUserData*>(block.userData());
+    auto data = TextBlockUserData::get(block);
     if (!data) {
         data = new TextBlockUserData();
         block.setUserData(data);
@@ -180,173 +534,438 @@ void SyntaxHighlighter::toggleBookmark(QTextBlock block)
 bool SyntaxHighlighter::isPositionInComment(int absPos, int len) const
 {
     const auto& block = document()->findBlock(absPos);
-    const auto t = block.text();
-    auto data = dynamic_cast<TextBlockUserData*>(block.userData());
-    if (!data)
-        return false;
-
-    const auto start = absPos - block.position();
-    return data->fmtList.isFormat(start, start + len, 'c');
+    return isInComment(block, absPos - block.position(), len);
 }
 
 bool SyntaxHighlighter::isPositionInString(int absPos, int len) const
 {
     const auto& block = document()->findBlock(absPos);
-    auto data = dynamic_cast<TextBlockUserData*>(block.userData());
+    return isInString(block, absPos - block.position(), len);
+}
+
+bool SyntaxHighlighter::isInComment(const QTextBlock& block, int offset, int len) const
+{
+    auto data = TextBlockUserData::get(block);
+    return data && data->fmtList.isFormat(offset, offset + len, 'c');
+}
+
+bool SyntaxHighlighter::isInString(const QTextBlock& block, int offset, int len) const
+{
+    auto data = TextBlockUserData::get(block);
+    return data && data->fmtList.isFormat(offset, offset + len, 's');
+}
+
+std::vector<char> SyntaxHighlighter::formatTypesAt(const QTextBlock& block, const std::vector<int>& offsets) const
+{
+    auto data = TextBlockUserData::get(block);
     if (!data)
-        return false;
+        return std::vector<char>(offsets.size(), 0);
 
-    const auto start = absPos - block.position();
-    return data->fmtList.isFormat(start, start + len, 's');
+    return data->fmtList.formatsAt(offsets);
 }
 
 void SyntaxHighlighter::startRehighlighting()
 {
-    const auto firstBlock = document()->firstBlock();
-    auto data = dynamic_cast<TextBlockUserData*>(firstBlock.userData());
-    if (data)
-        data->forceRehighlighting = true;
+    invalidate(true);
+}
+
+void SyntaxHighlighter::invalidate(bool keepStates)
+{
+    Q_D(SyntaxHighlighter);
+
+    if (!document())
+        return;
+
+    cancelJob();
+    d->pendingBlocks.clear();
+    d->checkpoint = -1;
+
+    // A new document: reserve the data of all its blocks at once.
+    if (!SyntaxHighlighterPrivate::userData(document()->firstBlock()))
+        TextBlockUserData::reserve(document()->blockCount());
+
+    for (auto block = document()->firstBlock(); block.isValid(); block = block.next())
+        d->markUnhighlighted(block, keepStates);
+
+    d->fillFrom = 0;
+    queueDispatch();
+}
+
+void SyntaxHighlighter::scheduleHighlighting(const QTextBlock& block)
+{
+    Q_D(SyntaxHighlighter);
+
+    if (!block.isValid())
+        return;
+
+    const int number = block.blockNumber();
+    d->pendingBlocks.insert(number);
 
-    if (firstBlock.isValid())
-        QMetaObject::invokeMethod(this, "rehighlightBlock", Qt::QueuedConnection, Q_ARG(QTextBlock, firstBlock));
+    // A running job that starts after this block is based on outdated states. Cancel it; its blocks
+    // are picked up again later.
+    if (d->jobRunning && number < d->jobFirstBlock) {
+        if (d->jobFromPending)
+            d->pendingBlocks.insert(d->jobFirstBlock);
+        cancelJob();
+    }
+
+    queueDispatch();
+}
+
+void SyntaxHighlighter::queueDispatch()
+{
+    Q_D(SyntaxHighlighter);
+    if (!d->dispatchQueued) {
+        d->dispatchQueued = true;
+        QTimer::singleShot(0, this, &SyntaxHighlighter::dispatchJob);
+    }
+}
+
+void SyntaxHighlighter::cancelJob()
+{
+    Q_D(SyntaxHighlighter);
+    ++*d->generation;
+    d->jobRunning = false;
+}
+
+void SyntaxHighlighter::dispatchJob()
+{
+    Q_D(SyntaxHighlighter);
+    d->dispatchQueued = false;
+
+    if (!m_enabled || d->jobRunning || !document())
+        return;
+
+    // Definitions are loaded lazily. Make sure this happens here and not on the worker thread.
+    d->ensureDefinitionLoaded();
+
+    // First the blocks following an edit, since the user is most likely looking at them.
+    if (!d->pendingBlocks.empty()) {
+        const QTextBlock block = document()->findBlockByNumber(*d->pendingBlocks.begin());
+        if (block.isValid()) {
+            startJob(block, false, true);
+            return;
+        }
+        d->pendingBlocks.clear(); // All pending blocks have been removed from the document
+    }
+
+    // Then the visible blocks of all views. Their start state comes from the closest block before them
+    // that has a state. If there's none right before them, the states in between are computed first
+    // without formatting anything.
+    const auto ranges = d->visibleRanges();
+    QTextBlock visible;
+    for (const auto& range : ranges) {
+        visible = SyntaxHighlighterPrivate::firstUnhighlighted(document()->findBlockByNumber(range.first), range.second);
+        if (visible.isValid())
+            break;
+    }
+
+    if (visible.isValid()) {
+        QTextBlock start = visible;
+        if (start.previous().isValid() && !SyntaxHighlighterPrivate::hasState(start.previous())) {
+            const QTextBlock checkpoint = document()->findBlockByNumber(d->checkpoint);
+
+            if (checkpoint.isValid() && checkpoint.blockNumber() < visible.blockNumber() &&
+                    SyntaxHighlighterPrivate::hasState(checkpoint)) {
+                start = checkpoint.next();
+            } else {
+                start = start.previous();
+                while (start.previous().isValid() && !SyntaxHighlighterPrivate::hasState(start.previous()))
+                    start = start.previous();
+            }
+        }
+
+        if (start == visible)
+            startJob(visible, false, false);
+        else
+            startJob(start, true, false, visible.blockNumber() - start.blockNumber());
+        return;
+    }
+
+    // Then the visible parts of lines that were too long to be highlighted at once.
+    for (const auto& range : ranges) {
+        const QTextBlock visibleEnd = document()->findBlockByNumber(range.second).next();
+        for (auto block = document()->findBlockByNumber(range.first); block.isValid() && block != visibleEnd;
+             block = block.next()) {
+            const auto data = SyntaxHighlighterPrivate::userData(block);
+            if (data && data->partial && data->highlighted &&
+                    (!block.previous().isValid() || SyntaxHighlighterPrivate::hasState(block.previous()))) {
+                startJob(block, false, false, 1, true);
+                return;
+            }
+        }
+    }
+
+    // Finally everything else, from top to bottom.
+    if (d->fillFrom >= 0) {
+        const QTextBlock block =
+            SyntaxHighlighterPrivate::firstUnhighlighted(document()->findBlockByNumber(d->fillFrom), -1);
+
+        d->fillFrom = block.isValid() ? block.blockNumber() : -1;
+        if (block.isValid())
+            startJob(block, false, false);
+    }
+}
+
+void SyntaxHighlighter::startJob(QTextBlock block, bool statesOnly, bool fromPending, int size, bool resume)
+{
+    Q_D(SyntaxHighlighter);
+
+    if (size < 0)
+        size = statesOnly ? STATES_JOB_SIZE : JOB_SIZE;
+    size = std::min(size, statesOnly ? STATES_JOB_SIZE : JOB_SIZE);
+
+    QSharedPointer<HighlightJob> job(new HighlightJob);
+    job->generation = ++*d->generation;
+    job->firstBlock = block.blockNumber();
+    job->statesOnly = statesOnly;
+    job->definition = definition();
+    job->startState = SyntaxHighlighterPrivate::blockState(block.previous());
+    job->maxLineLength = d->maxLineLength;
+    job->maxLineNsecs = d->maxLineNsecs;
+    if (resume)
+        job->resume.reset(new HighlightedBlock(*SyntaxHighlighterPrivate::userData(block)->partial));
+    job->texts.reserve(size);
+    job->oldStates.reserve(size);
+    job->highlighted.reserve(size);
+
+    for (int i = 0; i < size && block.isValid(); ++i, block = block.next()) {
+        job->texts.push_back(block.text());
+        job->oldStates.push_back(SyntaxHighlighterPrivate::blockState(block));
+        job->highlighted.push_back(SyntaxHighlighterPrivate::isHighlighted(block));
+    }
+
+    d->jobRunning = true;
+    d->jobFromPending = fromPending;
+    d->jobFirstBlock = job->firstBlock;
+    d->jobLastBlock = job->firstBlock + job->texts.size() - 1;
+    QMetaObject::invokeMethod(d->worker, "process", Qt::QueuedConnection,
+                              Q_ARG(QSharedPointer<ote::HighlightJob>, job));
+}
+
+void SyntaxHighlighter::applyResults(QSharedPointer<HighlightJob> job)
+{
+    Q_D(SyntaxHighlighter);
+
+    // A newer job has been started since, these results are outdated.
+    if (job->generation != *d->generation || !document())
+        return;
+
+    d->jobRunning = false;
+    DEFER { queueDispatch(); };
+
+    const QTextBlock first = document()->findBlockByNumber(job->firstBlock);
+    if (!first.isValid() || !(SyntaxHighlighterPrivate::blockState(first.previous()) == job->startState))
+        return;
+
+    // Each result only depends on the previous block's state and the block's text. Results are valid
+    // for as long as the texts are unchanged.
+    QTextBlock block = first;
+    int applied = 0;
+    for (auto& result : job->results) {
+        if (!block.isValid() || block.text() != job->texts.at(applied))
+            break;
+
+        auto userData = SyntaxHighlighterPrivate::userData(block);
+        if (!userData) {
+            userData = new TextBlockUserData();
+            block.setUserData(userData);
+        }
+
+        if (job->statesOnly) {
+            if (userData->highlighted && !(userData->state == result.state))
+                d->markUnhighlighted(block, true);
+            userData->state = result.state;
+            userData->hasState = true;
+        } else {
+            userData->pendingResult.reset(new HighlightedBlock(std::move(result)));
+        }
+
+        ++applied;
+        block = block.next();
+    }
+
+    if (applied == 0)
+        return;
+
+    const int last = job->firstBlock + applied - 1;
+
+    if (job->statesOnly) {
+        d->checkpoint = last;
+        return;
+    }
+
+    // highlightBlock() keeps QSyntaxHighlighter going through all blocks with a pending result.
+    d->applyingResults = true;
+    rehighlightBlock(first);
+    d->applyingResults = false;
+
+    d->pendingBlocks.erase(d->pendingBlocks.lower_bound(job->firstBlock), d->pendingBlocks.upper_bound(last));
+
+    // If the last block's state changed, blocks that were already highlighted need to be updated.
+    // Blocks that weren't are taken care of anyway.
+    if (applied == static_cast<int>(job->results.size()) && !job->converged && SyntaxHighlighterPrivate::hasState(block))
+        scheduleHighlighting(block);
 }
 
 void SyntaxHighlighter::setPluginBlockData(const QTextBlock& block, int id, std::unique_ptr<PluginBlockData> data)
 {
-    auto blockData = reinterpret_cast<TextBlockUserData*>(block.userData());
+    auto blockData = TextBlockUserData::get(block);
     Q_ASSERT_X(blockData, "SyntaxHighlighter", "blockData must not be null");
 
-    blockData->extraData[id] = std::move(data);
+    blockData->setPluginData(id, std::move(data));
 }
 
 PluginBlockData* SyntaxHighlighter::getPluginBlockData(const QTextBlock& block, int id)
 {
-    auto blockData = reinterpret_cast<TextBlockUserData*>(block.userData());
+    auto blockData = TextBlockUserData::get(block);
     Q_ASSERT_X(blockData, "SyntaxHighlighter", "blockData must not be null");
 
-    auto it = blockData->extraData.find(id);
-
-    if (it == blockData->extraData.end())
-        return nullptr;
-
-    return it->second.get();
+    return blockData->pluginData(id);
 }
 
 const PluginBlockData* SyntaxHighlighter::getPluginBlockData(const QTextBlock& block, int id) const
 {
-    auto blockData = reinterpret_cast<TextBlockUserData*>(block.userData());
+    auto blockData = TextBlockUserData::get(block);
     Q_ASSERT_X(blockData, "SyntaxHighlighter", "blockData must not be null");
 
-    auto it = blockData->extraData.find(id);
-
-    if (it == blockData->extraData.end())
-        return nullptr;
-
-    return it->second.get();
+    return blockData->pluginData(id);
 }
 
 void SyntaxHighlighter::highlightBlock(const QString& text)
 {
     Q_D(SyntaxHighlighter);
 
-    auto userData = dynamic_cast<TextBlockUserData*>(currentBlockUserData());
-    const bool newUserData = !userData;
-    if (newUserData) {
-        // TODO: All blocks get their TextBlockuserData objects created in one batch at
-        // the start. This blocks the main thread and leads to a short delay (~0.5s for 100k lines)
-        // Possible improvements:
-        //  * move this part outside the highlighter+ensure it'll be run before highlightBlock()
-        //  * Allocate a big chunk of memory and put all UserData objects in there.
+    auto userData = static_cast<TextBlockUserData*>(currentBlockUserData());
+    if (!userData) {
+        // All blocks get their TextBlockUserData objects created in one batch at the start. Their
+        // memory has been reserved in bulk by invalidate(), so this doesn't allocate.
         userData = new TextBlockUserData();
         setCurrentBlockUserData(userData);
     }
 
+    QTextBlock currBlock = currentBlock();
+
     if (!m_enabled)
         return;
 
-    QTextBlock currBlock = currentBlock();
-    State state;
-    if (currBlock.position() > 0) {
-        const auto prevBlock = currBlock.previous();
-        const auto prevData = dynamic_cast<TextBlockUserData*>(prevBlock.userData());
-        Q_ASSERT_X(prevData, "SyntaxHighlighter", "prevData should not be null");
-        state = prevData->state;
-    }
-    d->foldingRegions.clear();
-    d->fmtList.clear();
-    state = highlightLine(text, state);
-
-    // Note: This lambda is executed at function exit
-    DEFER { emit blockHighlighted(currBlock); };
+    // QSyntaxHighlighter discards the formats of the block before calling highlightBlock()
+    const auto setStoredFormats = [this, d, userData]() {
+        for (const auto& run : userData->formats) {
+            const auto& charFormat = d->charFormats[run.formatId];
+            if (!charFormat.isDefault)
+                setFormat(run.offset, run.length, charFormat.format);
+        }
+    };
 
-    if (newUserData) { // first time we highlight this
-        userData->state = state;
-        userData->foldingRegions = d->foldingRegions;
-        userData->fmtList = std::move(d->fmtList);
+    if (d->reapplying && !userData->pendingResult) {
+        setStoredFormats();
         return;
     }
-    const bool forceRehighlighted = userData->forceRehighlighting;
-    userData->forceRehighlighting = false;
-    userData->fmtList = std::move(d->fmtList);
 
-    // we ended up in the same state, so we are done here
-    if (!forceRehighlighted && userData->state == state && userData->foldingRegions == d->foldingRegions) {
+    std::unique_ptr<HighlightedBlock> result = std::move(userData->pendingResult);
+
+    // A resumed line only comes with the formats of its new part, which must continue where the
+    // block's formats end. If the line was highlighted again in the meantime, the part doesn't fit.
+    const bool resumed = result && result->resumedFrom >= 0;
+    if (resumed && !(userData->partial && userData->partial->partialOffset == result->resumedFrom)) {
+        setStoredFormats();
         return;
     }
-    userData->state = state;
-    userData->foldingRegions = d->foldingRegions;
 
-    const auto nextBlock = currBlock.next();
-    if (!nextBlock.isValid()) {
-        return;
+    if (!result) {
+        // The block was edited. Highlight it right away so typing doesn't flicker, unless a lot of
+        // blocks were changed at once or the start state isn't known yet. Those are highlighted in
+        // the background. Marking the block also makes sure the background fill revisits everything
+        // after the edit, whose block numbers may have shifted.
+        const QTextBlock prevBlock = currBlock.previous();
+        if (d->syncBlocks >= MAX_SYNC_BLOCKS || (prevBlock.isValid() && !SyntaxHighlighterPrivate::hasState(prevBlock))) {
+            d->markUnhighlighted(currBlock, false);
+            queueDispatch();
+            return;
+        }
+
+        if (d->fillFrom > currBlock.blockNumber())
+            d->fillFrom = currBlock.blockNumber();
+
+        if (d->syncBlocks++ == 0)
+            QTimer::singleShot(0, this, [d]() { d->syncBlocks = 0; });
+
+        result.reset(new HighlightedBlock);
+        d->current = result.get();
+        const State prevState = SyntaxHighlighterPrivate::blockState(prevBlock);
+        if (text.isEmpty()) {
+            result->state = highlightLine(text, prevState);
+        } else {
+            // A long line is only highlighted in part here. The rest follows in the background.
+            int stoppedAt = 0;
+            result->state = highlightLine(text, prevState, 0, d->maxLineLength, d->maxLineNsecs, &stoppedAt);
+            if (stoppedAt < text.size()) {
+                result->partialOffset = stoppedAt;
+                result->resumeState = result->state;
+                result->state = lineEndState(result->state);
+            }
+        }
+        d->current = nullptr;
     }
 
-    if (forceRehighlighted) { // Proliferate rehighlighting to next block if needed
-        auto nextData = dynamic_cast<TextBlockUserData*>(nextBlock.userData());
-        Q_ASSERT_X(nextData, "SyntaxHighlighter", "nextData should not be null");
-        nextData->forceRehighlighting = true;
+    if (resumed)
+        setStoredFormats();
+    else
+        userData->formats.clear();
+
+    userData->formats.reserve(userData->formats.size() + result->formats.size());
+    for (const auto& run : result->formats) {
+        const auto& charFormat = d->charFormat(run.format);
+        if (!charFormat.isDefault)
+            setFormat(run.offset, run.length, charFormat.format);
+        userData->formats.push_back({run.offset, run.length, run.format.id()});
     }
 
-    // The highlighter will automagically keep highlighting text blocks for as long as the block's user state
-    // has changed during highlighting. However, this runs on the main thread so we shouldn't let it execute too
-    // often in a row. Every some iterations we instead queue up the highlighting to continue on next tick.
-    // It's good to immediately queue once in order to not block the main thread during program creation.
-    if (s_continuousIterations++ % 256 == 0) {
-        QMetaObject::invokeMethod(this, "rehighlightBlock", Qt::QueuedConnection, Q_ARG(QTextBlock, nextBlock));
+    // Keep what's needed to continue a partially highlighted line once it's visible.
+    if (result->partialOffset >= 0) {
+        userData->partial.reset(new HighlightedBlock);
+        userData->partial->partialOffset = result->partialOffset;
+        userData->partial->resumeState = result->resumeState;
+        userData->partial->foldingRegions = result->foldingRegions;
+        queueDispatch();
+    } else {
+        userData->partial.reset();
     }
-    else
-        currBlock.setUserState(currBlock.userState() + 1);
-}
 
-void SyntaxHighlighter::applyFormat(int offset, int length, const Format& format)
-{
-    if (format.isDefaultTextStyle(theme()) || length == 0)
-        return;
+    const bool stateChanged = !userData->hasState || !(userData->state == result->state);
+    userData->state = result->state;
+    userData->hasState = true;
+    userData->highlighted = true;
+    if (!(userData->foldingRegions == result->foldingRegions))
+        d->foldingIndex.invalidateFrom(currBlock.blockNumber());
+    userData->foldingRegions = std::move(result->foldingRegions);
+    if (resumed)
+        userData->fmtList.append(result->fmtList);
+    else
+        userData->fmtList = std::move(result->fmtList);
 
-    QTextCharFormat tf;
-    if (format.hasTextColor(theme()))
-        tf.setForeground(format.textColor(theme()));
-    if (format.hasBackgroundColor(theme()))
-        tf.setBackground(format.backgroundColor(theme()));
+    emit blockHighlighted(currBlock);
 
-    if (format.isBold(theme()))
-        tf.setFontWeight(QFont::Bold);
-    if (format.isItalic(theme()))
-        tf.setFontItalic(true);
-    if (format.isUnderline(theme()))
-        tf.setFontUnderline(true);
-    if (format.isStrikeThrough(theme()))
-        tf.setFontStrikeOut(true);
+    const auto nextBlock = currBlock.next();
+    if (!nextBlock.isValid())
+        return;
 
-    if (format.isComment()) {
-        Q_D(SyntaxHighlighter);
-        d->fmtList.append(offset, offset + length, 'c');
-    } else if (format.isString()) {
-        Q_D(SyntaxHighlighter);
-        d->fmtList.append(offset, offset + length, 's');
+    if (d->applyingResults) {
+        // QSyntaxHighlighter continues with the next block as long as the user state changes.
+        const auto nextData = TextBlockUserData::get(nextBlock);
+        if (nextData && nextData->pendingResult)
+            currBlock.setUserState(currBlock.userState() + 1);
+    } else if (stateChanged && SyntaxHighlighterPrivate::hasState(nextBlock)) {
+        // The following blocks depend on this block's state and need to be rehighlighted.
+        scheduleHighlighting(nextBlock);
     }
+}
 
-    QSyntaxHighlighter::setFormat(offset, length, tf);
+void SyntaxHighlighter::applyFormat(int offset, int length, const Format& format)
+{
+    Q_D(SyntaxHighlighter);
+    d->current->addFormat(offset, length, format);
 }
 
 void SyntaxHighlighter::applyFolding(int offset, int length, FoldingRegion region)
@@ -354,19 +973,7 @@ void SyntaxHighlighter::applyFolding(int offset, int length, FoldingRegion regio
     Q_UNUSED(offset);
     Q_UNUSED(length);
     Q_D(SyntaxHighlighter);
-
-    if (region.type() == FoldingRegion::Begin)
-        d->foldingRegions.push_back(region);
-
-    if (region.type() == FoldingRegion::End) {
-        for (int i = d->foldingRegions.size() - 1; i >= 0; --i) {
-            if (d->foldingRegions.at(i).id() != region.id() || d->foldingRegions.at(i).type() != FoldingRegion::Begin)
-                continue;
-            d->foldingRegions.remove(i);
-            return;
-        }
-        d->foldingRegions.push_back(region);
-    }
+    d->current->addFolding(region);
 }
 
 } // namespace ote
@@ -28,8 +28,12 @@
 
 #include "abstracthighlighter.h"
 
+#include <QSharedPointer>
 #include <QSyntaxHighlighter>
 
+#include <memory>
+#include <vector>
+
 namespace ote {
 
 class PluginBlockData {
@@ -38,11 +42,24 @@ public:
 };
 
 class SyntaxHighlighterPrivate;
+struct HighlightJob;
 
 /** A QSyntaxHighlighter implementation for use with QTextDocument.
  *  This supports partial re-highlighting during editing and
  *  tracks syntax-based code folding regions.
  *
+ *  Edited blocks are highlighted immediately. Everything else, like the blocks
+ *  following an edit whose state changed or the whole document after loading it,
+ *  is highlighted on a background thread. The results are
+ *  applied on the GUI thread if the text they were computed from is unchanged.
+ *
+ *  Background highlighting first handles the blocks following an edit until their
+ *  states converge, then the visible blocks, then the rest of the document.
+ *
+ *  Changing the theme doesn't rerun the rule engine. Each block keeps its format
+ *  runs, which are only converted for the new theme and reapplied, visible blocks
+ *  first.
+ *
  *  @since 5.28
  */
 class SyntaxHighlighter : public QSyntaxHighlighter, public AbstractHighlighter
@@ -53,9 +70,17 @@ public:
     explicit SyntaxHighlighter(QTextDocument *document);
     ~SyntaxHighlighter() override;
 
+    /**
+     * Same as QSyntaxHighlighter::setDocument(). Also keeps the block numbers of the pending
+     * background work up to date when blocks are inserted or removed, which must happen before
+     * QSyntaxHighlighter rehighlights the changed blocks. Call this and not the base class'.
+     */
+    void setDocument(QTextDocument *doc);
+
     void setEnabled(bool enabled);
 
     void setDefinition(const Definition &def) override;
+    void setTheme(const Theme &theme) override;
 
     /** Returns whether there is a folding region beginning at @p startBlock.
      *  This only considers syntax-based folding regions,
@@ -71,14 +96,16 @@ public:
      *  This returns an invalid block if no folding region end is found,
      *  which typically indicates an unterminated region and thus folding
      *  until the document end.
-     *  This method performs a sequential search starting at @p startBlock
-     *  for the matching folding region end, which is a potentially expensive
-     *  operation.
+     *  Regions are looked up in an index of the document's folding regions,
+     *  which is updated after edits from the first changed block on.
      *
      *  @see startsFoldingRegion
      */
     QTextBlock findFoldingRegionEnd(const QTextBlock& startBlock) const;
 
+    /** Finds the closest block at or before @p startBlock that begins a
+     *  folding region, or an invalid block if there is none.
+     */
     QTextBlock findFoldingRegionBegin(const QTextBlock& startBlock) const;
 
     bool isBookmarked(const QTextBlock& block) const;
@@ -95,11 +122,44 @@ public:
      */
     bool isPositionInString(int absPos, int len=0) const;
 
+    /**
+     * Same as isPositionInComment() and isPositionInString() with a position relative to
+     * @p block, which saves looking up the block.
+     */
+    bool isInComment(const QTextBlock& block, int offset, int len=0) const;
+    bool isInString(const QTextBlock& block, int offset, int len=0) const;
+
+    /**
+     * Classifies the ascending @p offsets in @p block at once: the result holds 'c' for each
+     * offset inside a comment, 's' for each offset inside a string and 0 otherwise.
+     */
+    std::vector<char> formatTypesAt(const QTextBlock& block, const std::vector<int>& offsets) const;
+
     /**
      * Starts an asynchronous rehighighting job for the whole document.
      */
     void startRehighlighting();
 
+    /**
+     * Tells the highlighter which blocks are currently visible in @p view. Visible blocks of
+     * all views are highlighted before the rest of the document.
+     */
+    void setVisibleBlocks(const QObject* view, int first, int last);
+
+    /**
+     * Forgets the visible blocks of @p view, e.g. when it's destroyed.
+     */
+    void removeVisibleBlocks(const QObject* view);
+
+    /**
+     * Sets the budget for highlighting a single line. Lines longer than @p maxLength
+     * characters, or taking longer than @p maxMsecs, are only highlighted up to that
+     * point, leaving the rest unformatted. Highlighting continues in the background
+     * while the line is visible, each time at least doubling the highlighted part
+     * regardless of @p maxMsecs. Pass 0 to disable a limit.
+     */
+    void setLineBudget(int maxLength, int maxMsecs);
+
 
     void setPluginBlockData(const QTextBlock& block, int id, std::unique_ptr<PluginBlockData> data);
     PluginBlockData* getPluginBlockData(const QTextBlock& block, int id);
@@ -117,8 +177,43 @@ protected:
     void applyFolding(int offset, int length, FoldingRegion region) override;
 
 private:
+    void initWorker();
+
+    /**
+     * Shifts the block numbers of the pending background work and invalidates the folding index
+     * when blocks were inserted or removed.
+     */
+    void onContentsChange(int position, int removed, int added);
+
+    /**
+     * Marks all blocks as unhighlighted and starts rehighlighting them.
+     * @param keepStates If true, the blocks' states are kept as starting points.
+     */
+    void invalidate(bool keepStates);
+
+    /**
+     * Queues background highlighting starting at @p block until the states converge.
+     */
+    void scheduleHighlighting(const QTextBlock& block);
+    void queueDispatch();
+    void cancelJob();
+
+    /**
+     * Starts the next background job: blocks following an edit, then visible blocks, then the rest.
+     */
+    void dispatchJob();
+    void startJob(QTextBlock block, bool statesOnly, bool fromPending, int size = -1, bool resume = false);
+    void applyResults(QSharedPointer<HighlightJob> job);
+
+    /**
+     * Reapplies the stored format runs of the highlighted blocks from @p block up to block
+     * number @p last (-1 for the end of the document), at most @p maxBlocks of them.
+     * Returns the block after the last one visited.
+     */
+    QTextBlock reapplyFormats(QTextBlock block, int last, int maxBlocks);
+    void reapplyFormatsBatch();
+
     bool m_enabled = true;
-    static unsigned int s_continuousIterations;
 
     Q_DECLARE_PRIVATE_D(AbstractHighlighter::d_ptr, SyntaxHighlighter)
 };
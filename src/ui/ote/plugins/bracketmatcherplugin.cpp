@@ -121,14 +121,22 @@ void ote::BracketMatcherPlugin::onBlockHighlighted(const QTextBlock& b)
     const auto* hl = getTextEdit()->getHighlighter();
     const auto& text = b.text();
     const auto textSize = text.size();
-    const auto blockPos = b.position();
 
+    std::vector<int> offsets;
     for (int i = 0; i < textSize; ++i) {
         const char c = text.at(i).toLatin1();
-        if ((isLeftBracket(c) || isRightBracket(c)) && !hl->isPositionInString(blockPos + i) &&
-            !hl->isPositionInComment(blockPos + i)) {
-            data->brackets.push_back({c, i});
-        }
+        if (isLeftBracket(c) || isRightBracket(c))
+            offsets.push_back(i);
+    }
+
+    if (offsets.empty())
+        return;
+
+    // Brackets inside strings and comments don't count.
+    const auto types = hl->formatTypesAt(b, offsets);
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        if (types[i] == 0)
+            data->brackets.push_back({text.at(offsets[i]).toLatin1(), offsets[i]});
     }
 }
 
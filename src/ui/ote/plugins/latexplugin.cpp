@@ -108,7 +108,7 @@ void LatexPlugin::onBlockHighlighted(const QTextBlock& block)
         auto m = it.next();
 
         if (!m.captured(1).isEmpty() &&
-            hl->isPositionInComment(blockStartPos + m.capturedStart(1), m.capturedLength(1))) {
+            hl->isInComment(block, m.capturedStart(1), m.capturedLength(1))) {
             matches.push_back(std::move(m));
         }
     }
@@ -17,6 +17,7 @@
 #include <QRegularExpression>
 #include <QScrollBar>
 #include <QTextBlock>
+#include <QTextDocument>
 
 #include <algorithm>
 #include <cmath>
@@ -70,20 +71,51 @@ Config Config::readFromSettings(const QSettings& settings)
 
 Repository* TextEdit::s_repository = nullptr;
 
+TextEdit::SharedDocument::~SharedDocument()
+{
+    // The last view is being destroyed and may still reference the document.
+    if (document)
+        document->deleteLater();
+}
+
 TextEdit::TextEdit(QWidget* parent, Config cfg)
+    : TextEdit(parent, nullptr, cfg)
+{
+}
+
+TextEdit::TextEdit(QWidget* parent, TextEdit* sharedWith, Config cfg)
     : QPlainTextEdit(parent)
+    , m_shared(sharedWith ? sharedWith->m_shared : std::make_shared<SharedDocument>())
     , m_sideBar(new TextEditGutter(this,cfg))
-    , m_highlighter(new SyntaxHighlighter(this))
 {
+    const bool newDocument = !m_shared->document;
+    if (newDocument) {
+        // The document isn't owned by this view since it may outlive it.
+        auto doc = new QTextDocument();
+        doc->setDocumentLayout(new QPlainTextDocumentLayout(doc));
+        m_shared->document = doc;
+        m_shared->highlighter = new SyntaxHighlighter(static_cast<QObject*>(doc));
+
+        // All views need to update their EditorLabels before the highlighter sees the change.
+        SharedDocument* shared = m_shared.get();
+        connect(doc, &QTextDocument::contentsChange, doc, [shared](int position, int removed, int added) {
+            for (auto view : shared->views)
+                view->onContentsChange(position, removed, added);
+        });
+    }
+    m_shared->views.push_back(this);
+    m_highlighter = m_shared->highlighter;
+    QPlainTextEdit::setDocument(m_shared->document);
+
     connect(&m_cursorTimer, &QTimer::timeout, this, &TextEdit::onCursorRepaint);
     connect(this, &QPlainTextEdit::blockCountChanged, this, &TextEdit::updateSidebarGeometry);
     connect(this, &QPlainTextEdit::updateRequest, this, &TextEdit::updateSidebarArea);
     connect(this, &QPlainTextEdit::cursorPositionChanged, this, &TextEdit::onCursorPositionChanged); // slot
     connect(this, &QPlainTextEdit::selectionChanged, this, &TextEdit::onSelectionChanged);
-    connect(document(), &QTextDocument::contentsChange, this, &TextEdit::onContentsChange);
     connect(m_highlighter, &ote::SyntaxHighlighter::blockHighlighted, this, &TextEdit::blockHighlighted);
 
-    m_highlighter->setDocument(document()); // Important to set this *after* the blockChanged connect
+    if (newDocument)
+        m_highlighter->setDocument(document()); // Important to set this *after* the contentsChange connect
 
     // Some config options need some extra work. We'll set them manually.
     setWordWrap(cfg.wordWrap);
@@ -99,10 +131,24 @@ TextEdit::TextEdit(QWidget* parent, Config cfg)
     onCursorPositionChanged();
 }
 
+TextEdit::~TextEdit()
+{
+    m_highlighter->removeVisibleBlocks(this);
+
+    auto& views = m_shared->views;
+    views.erase(std::remove(views.begin(), views.end(), this), views.end());
+}
+
+bool TextEdit::isDocumentShared() const
+{
+    return m_shared->views.size() > 1;
+}
+
 void TextEdit::setTheme(const Theme& theme)
 {
-    if (theme == getTheme())
+    if (theme == m_theme)
         return;
+    m_theme = theme;
 
     auto pal = qApp->palette();
     if (theme.isValid()) {
@@ -113,8 +159,8 @@ void TextEdit::setTheme(const Theme& theme)
     setPalette(pal);
     viewport()->setPalette(pal);
 
-    m_highlighter->setTheme(theme);
-    m_highlighter->startRehighlighting();
+    if (!(theme == m_highlighter->theme()))
+        m_highlighter->setTheme(theme); // Reapplies the existing highlighting with the new colors
     m_sideBar->setTheme(theme);
 
     onCursorPositionChanged();
@@ -142,10 +188,10 @@ void TextEdit::highlightCurrentLine()
     setExtraSelections(ESLineHighlight, ExtraSelectionList() << selection);
 }
 
-void TextEdit::initRepository(const QString& path)
+void TextEdit::initRepository(const QString& path, const QString& cachePath)
 {
     delete s_repository;
-    s_repository = new Repository(path);
+    s_repository = new Repository(path, cachePath);
 }
 
 void TextEdit::setDefinition(const Definition& d)
@@ -532,7 +578,7 @@ void TextEdit::setModified(bool modified)
     // If modification is set to false we can assume the document was saved.
     // In this case, store the current revision so we know what lines are changed in the future.
     if (!modified)
-        m_lastSavedRevision = document()->revision();
+        m_shared->lastSavedRevision = document()->revision();
     document()->setModified(modified);
 }
 
@@ -702,8 +748,8 @@ void TextEdit::setPlainText(const QString &text)
     QPlainTextEdit::setPlainText(text);
     m_highlighter->setEnabled(true);
 
-    m_initialRevision = document()->revision();
-    m_lastSavedRevision = m_initialRevision;
+    m_shared->initialRevision = document()->revision();
+    m_shared->lastSavedRevision = m_shared->initialRevision;
 }
 
 // pair.first = number of ws characters found, pair.second = number of spaces needed
@@ -863,10 +909,21 @@ void TextEdit::updateSidebarGeometry()
 
 void TextEdit::updateSidebarArea(const QRect& rect, int dy)
 {
-    if (dy)
+    if (dy) {
         m_sideBar->scroll(0, dy);
-    else
+        updateHighlighterViewport();
+    } else {
         m_sideBar->update(0, rect.y(), m_sideBar->width(), rect.height());
+    }
+}
+
+void TextEdit::updateHighlighterViewport()
+{
+    const auto first = firstVisibleBlock();
+    const auto last = cursorForPosition(viewport()->rect().bottomLeft()).block();
+
+    if (first.isValid() && last.isValid())
+        m_highlighter->setVisibleBlocks(this, first.blockNumber(), last.blockNumber());
 }
 
 void TextEdit::onCursorPositionChanged()
@@ -2170,6 +2227,7 @@ void TextEdit::resizeEvent(QResizeEvent* event)
 {
     QPlainTextEdit::resizeEvent(event);
     updateSidebarGeometry();
+    updateHighlighterViewport();
 
     if (wordWrapMode() != QTextOption::NoWrap)
         redrawAllEditorLabels();
@@ -2191,14 +2249,7 @@ QTextBlock TextEdit::findEndOfFoldingRegion(const QTextBlock& startBlock) const
 
 QTextBlock TextEdit::findBeginOfFoldingRegion(const QTextBlock& startBlock) const
 {
-    if (m_highlighter->startsFoldingRegion(startBlock))
-        return startBlock;
-
-    auto block = startBlock.previous();
-    while(block.isValid() && ! m_highlighter->startsFoldingRegion(block))
-        block = block.previous();
-
-    return block;
+    return m_highlighter->findFoldingRegionBegin(startBlock);
 }
 
 bool TextEdit::isBlockFolded(const QTextBlock& block) const
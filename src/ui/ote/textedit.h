@@ -5,6 +5,7 @@
 #include <QTextBlock>
 #include <QTimer>
 
+#include <memory>
 #include <vector>
 
 #include "Highlighter/theme.h"
@@ -63,16 +64,29 @@ class TextEdit : public QPlainTextEdit
 public:
     TextEdit(QWidget* parent, Config cfg = Config());
 
+    /**
+     * Creates another view of @p sharedWith's document. The views share the text, undo history,
+     * syntax highlighter and highlighting data, so the document is only stored and highlighted
+     * once. Each view has its own cursors, selections, scroll position and editor labels.
+     * Folding is shared since it is stored in the document's text blocks.
+     */
+    TextEdit(QWidget* parent, TextEdit* sharedWith, Config cfg = Config());
+    ~TextEdit() override;
+
+    // Returns whether other TextEdits show the same document.
+    bool isDocumentShared() const;
+
     /**
      * Repository
      * The repository contains all loaded themes and syntax definitions. It needs to be initialized
      * beofre constructing and using TextEdit objects. You should call initRepository before doing
      * anything else with OTE.
+     * If cachePath is not empty, syntax folder indexes and loaded syntax definitions are cached there.
      */
     static Repository& getRepository() {
         return *s_repository;
     }
-    static void initRepository(const QString& path);
+    static void initRepository(const QString& path, const QString& cachePath = QString());
 
     const Config& getConfig() const { return m_config; }
 
@@ -393,6 +407,9 @@ private:
     void updateSidebarGeometry();
     void updateSidebarArea(const QRect& rect, int dy);
 
+    // Lets the highlighter know which blocks to highlight first.
+    void updateHighlighterViewport();
+
     // Used when all EditorLabels need to be redrawn, e.g. when font size or
     // editor geometry changes.
     void redrawAllEditorLabels();
@@ -474,10 +491,21 @@ private:
     QTimer m_cursorTimer;
     // True if flashing cursors should be drawn at the moment.
     bool m_drawCursorsOn = true;
-    // Contains the QTextDocument revision that was current when this document was last set to unmodified.
-    int m_lastSavedRevision = 0;
-    // Contains the QTextDocument revision that was current when this document was last loaded/reloaded.
-    int m_initialRevision = 0;
+    // The document and everything that belongs to it, shared by all TextEdits showing it.
+    struct SharedDocument {
+        ~SharedDocument();
+
+        QTextDocument* document = nullptr;
+        SyntaxHighlighter* highlighter = nullptr; // Owned by document
+        std::vector<TextEdit*> views;
+        // Contains the QTextDocument revision that was current when this document was last set to unmodified.
+        int lastSavedRevision = 0;
+        // Contains the QTextDocument revision that was current when this document was last loaded/reloaded.
+        int initialRevision = 0;
+    };
+    std::shared_ptr<SharedDocument> m_shared;
+    // The theme applied to this view. The highlighter's theme may already have been changed by another view.
+    Theme m_theme;
 
     enum class McsTriggerState {
         NoTrigger,  // Trigger not pressed
@@ -375,8 +375,8 @@ void TextEditGutter::paintEditStrip(QPainter& p, const TextEdit::BlockList& bl)
     const auto unsavedChanges = QBrush(m_theme.editorColor(Theme::ModifiedLines));
     const auto savedChanges = QBrush(m_theme.editorColor(Theme::SavedLines));
 
-    const int savedRevision = m_textEdit->m_lastSavedRevision;
-    const int initialRevision = m_textEdit->m_initialRevision;
+    const int savedRevision = m_textEdit->m_shared->lastSavedRevision;
+    const int initialRevision = m_textEdit->m_shared->initialRevision;
 
     for (const auto& blockData : bl) {
         const auto& block = blockData.block;
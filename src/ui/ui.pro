@@ -62,109 +62,9 @@ INSTALLFILESDIR = ../../support_files
 
 CURRFILE = $$PWD/ui.pro
 
-include(ote/OpenTextEdit.pri)
-
-SOURCES += main.cpp\
-    mainwindow.cpp \
-    topeditorcontainer.cpp \
-    editortabwidget.cpp \
-    docengine.cpp \
-    frmabout.cpp \
-    notepadqq.cpp \
-    frmpreferences.cpp \
-    iconprovider.cpp \
-    EditorNS/editor.cpp \
-    EditorNS/bannerfilechanged.cpp \
-    EditorNS/bannerbasicmessage.cpp \
-    EditorNS/bannerfileremoved.cpp \
-    clickablelabel.cpp \
-    frmencodingchooser.cpp \
-    EditorNS/bannerindentationdetected.cpp \
-    frmindentationmode.cpp \
-    singleapplication.cpp \
-    localcommunication.cpp \
-    Search/frmsearchreplace.cpp \
-    Search/searchstring.cpp \
-    Search/advancedsearchdock.cpp \
-    Extensions/extension.cpp \
-    frmlinenumberchooser.cpp \
-    Extensions/extensionsserver.cpp \
-    Extensions/Stubs/stub.cpp \
-    Extensions/runtimesupport.cpp \
-    Extensions/Stubs/windowstub.cpp \
-    Extensions/Stubs/notepadqqstub.cpp \
-    Extensions/Stubs/editorstub.cpp \
-    Extensions/extensionsloader.cpp \
-    globals.cpp \
-    Extensions/Stubs/menuitemstub.cpp \
-    Extensions/installextension.cpp \
-    keygrabber.cpp \
-    Sessions/sessions.cpp \
-    Sessions/persistentcache.cpp \
-    nqqsettings.cpp \  
-    nqqrun.cpp \
-    Search/filesearcher.cpp \
-    Search/filereplacer.cpp \
-    Search/searchobjects.cpp \
-    Search/searchinstance.cpp \
-    stats.cpp \
-    Sessions/backupservice.cpp
-
-HEADERS  += include/mainwindow.h \
-    include/topeditorcontainer.h \
-    include/editortabwidget.h \
-    include/docengine.h \
-    include/frmabout.h \
-    include/notepadqq.h \
-    include/frmpreferences.h \
-    include/iconprovider.h \
-    include/EditorNS/editor.h \
-    include/EditorNS/bannerfilechanged.h \
-    include/EditorNS/bannerbasicmessage.h \
-    include/EditorNS/bannerfileremoved.h \
-    include/clickablelabel.h \
-    include/frmencodingchooser.h \
-    include/EditorNS/bannerindentationdetected.h \
-    include/frmindentationmode.h \
-    include/singleapplication.h \
-    include/localcommunication.h \
-    include/Search/frmsearchreplace.h \
-    include/Search/advancedsearchdock.h \
-    include/Search/searchhelpers.h \
-    include/Search/searchstring.h \
-    include/Extensions/extension.h \
-    include/frmlinenumberchooser.h \
-    include/Extensions/extensionsserver.h \
-    include/Extensions/Stubs/stub.h \
-    include/Extensions/runtimesupport.h \
-    include/Extensions/Stubs/windowstub.h \
-    include/Extensions/Stubs/notepadqqstub.h \
-    include/Extensions/Stubs/editorstub.h \
-    include/Extensions/extensionsloader.h \
-    include/globals.h \
-    include/Extensions/Stubs/menuitemstub.h \
-    include/Extensions/installextension.h \
-    include/keygrabber.h \
-    include/Sessions/sessions.h \
-    include/Sessions/persistentcache.h \
-    include/nqqsettings.h \
-    include/nqqrun.h \
-    include/Search/filesearcher.h \
-    include/Search/searchobjects.h \
-    include/Search/filereplacer.h \
-    include/Search/searchinstance.h \
-    include/stats.h \
-    include/Sessions/backupservice.h
-
-FORMS    += mainwindow.ui \
-    frmabout.ui \
-    frmpreferences.ui \
-    frmencodingchooser.ui \
-    frmindentationmode.ui \
-    Search/dlgsearching.ui \
-    Search/frmsearchreplace.ui \
-    frmlinenumberchooser.ui \
-    Extensions/installextension.ui
+include(ui.pri)
+
+SOURCES += main.cpp
 
 RESOURCES += \
     resources.qrc
@@ -207,12 +107,18 @@ system($${LRELEASE} \"$${CURRFILE}\")
 
 ### EXTRA TARGETS ###
 
-# Copy the data in the "shared" folder
+# Copy the data in the "shared" folder, then index the syntax definitions
+# so that they don't need to be parsed on startup (see src/syntaxindexer)
+SYNTAXINDEXER = ../../out/build_tools/syntaxindexer
+win32: SYNTAXINDEXER = $${SYNTAXINDEXER}.exe
+
 dataTarget.target = make_data
 dataTarget.commands = (cd \"$$PWD\" && \
                          $${CMD_FULLDELETE} \"$$APPDATADIR/data\" && \
                          cd \"../data\" && \
-                         $(MAKE) DESTDIR=\"$$APPDATADIR/data\")
+                         $(MAKE) DESTDIR=\"$$APPDATADIR/data\") && \
+                      (cd \"$$PWD\" && \
+                         \"$$SYNTAXINDEXER\" \"$$APPDATADIR/data/syntax\")
 
 # Copy the extension_tools in the "shared" folder
 extensionToolsTarget.target = make_extensionTools